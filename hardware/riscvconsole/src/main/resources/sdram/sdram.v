@@ -44,7 +44,9 @@ module sdram
     parameter    SDRAM_REFRESH_CNT     = 2 ** SDRAM_ROW_W,
     parameter    SDRAM_START_DELAY     = 100000 / (1000 / SDRAM_MHZ), // 100uS
     parameter    SDRAM_REFRESH_CYCLES  = (64000*SDRAM_MHZ) / SDRAM_REFRESH_CNT-1,
-    parameter    SDRAM_READ_LATENCY    = 2
+    parameter    SDRAM_READ_LATENCY    = 2,
+    parameter    SDRAM_ADDR_MAP        = 0, // ADDR_MAP_*
+    parameter    SDRAM_REFRESH_POSTPONE = 8 // Refreshes that may wait for the bus to go idle (JEDEC: up to 8)
 )
 
 //-----------------------------------------------------------------
@@ -64,6 +66,13 @@ module sdram
     output [31:0]   data_o,
     output          stall_o,
     output          ack_o,
+
+    // Events, one clock pulses for performance counters
+    output          evt_read_o,
+    output          evt_write_o,
+    output          evt_row_hit_o,
+    output          evt_row_miss_o,
+    output          evt_refresh_o,
     
     // SDRAM Interface
     output                      sdram_clk_o,
@@ -118,6 +127,11 @@ localparam STATE_WRITE1      = 4'd7;
 localparam STATE_PRECHARGE   = 4'd8;
 localparam STATE_REFRESH     = 4'd9;
 
+// Address mapping, from the column bits up
+localparam ADDR_MAP_RBC      = 0; // Bank, row
+localparam ADDR_MAP_BRC      = 1; // Row, bank
+localparam ADDR_MAP_XOR      = 2; // Bank XOR low row bits, row
+
 localparam AUTO_PRECHARGE    = 10;
 localparam ALL_BANKS         = 10;
 
@@ -127,6 +141,7 @@ localparam CYCLE_TIME_NS     = 1000 / SDRAM_MHZ;
 localparam SDRAM_TRCD_CYCLES = (20 + (CYCLE_TIME_NS-1)) / CYCLE_TIME_NS;
 localparam SDRAM_TRP_CYCLES  = (20 + (CYCLE_TIME_NS-1)) / CYCLE_TIME_NS;
 localparam SDRAM_TRFC_CYCLES = (60 + (CYCLE_TIME_NS-1)) / CYCLE_TIME_NS;
+localparam SDRAM_TRAS_CYCLES = (42 + (CYCLE_TIME_NS-1)) / CYCLE_TIME_NS;
 
 // SDRAM number of mems
 localparam SDRAM_MEMS = SDRAM_DQM_W >> 1;
@@ -158,7 +173,8 @@ reg [SDRAM_DQM_W-1:0]  dqm_buffer_q;
 
 wire [SDRAM_DATA_W-1:0] sdram_data_in_w;
 
-reg                    refresh_q;
+reg                    refresh_q;      // Refresh now
+reg [3:0]              refresh_pend_q; // Refreshes due and not issued yet
 
 reg [SDRAM_BANKS-1:0]  row_open_q;
 reg [SDRAM_ROW_W-1:0]  active_row_q[0:SDRAM_BANKS-1];
@@ -169,14 +185,52 @@ reg  [STATE_W-1:0]     target_state_r;
 reg  [STATE_W-1:0]     target_state_q;
 reg  [STATE_W-1:0]     delay_state_q;
 
+// Reads in flight, by clocks since the READ command
+reg [SDRAM_READ_LATENCY+1:0]  rd_q;
+
+// Lookahead: the next request shows up on the bus while the current one
+// is still transferring. Its bank can be activated, or precharged to open
+// another row, in the command slots the transfer leaves free, as long as
+// it is not the bank being transferred.
+//
+// This acts on a request before it is accepted, so the master must hold a
+// request (stb_i, we_i, addr_i, data_i, sel_i) unchanged until stall_o is
+// low, as Wishbone pipelined mode asks: a request withdrawn or changed
+// while stalled leaves a row opened or closed for nothing at best. Only a
+// request already stalled for a clock is looked at, so a new one that
+// shows up in the clock its predecessor is accepted is not acted on before
+// the master is bound to it.
+reg [SDRAM_BANK_W-1:0] cur_bank_q;   // Bank of the last READ / WRITE
+reg [3:0]              la_wait_q;    // tRCD / tRP left after a lookahead command
+reg                    la_held_q;    // Request stalled last clock
+reg [3:0]              ras_q[0:SDRAM_BANKS-1]; // tRAS left per bank
+wire [SDRAM_BANKS-1:0] ras_busy_w;
+
 // Address bits
 wire [SDRAM_ROW_W-1:0]  addr_col_w  = {{(SDRAM_ROW_W-SDRAM_COL_W){1'b0}}, addr_i[SDRAM_COL_W:2], 1'b0};
-wire [SDRAM_ROW_W-1:0]  addr_row_w  = addr_i[SDRAM_ADDR_W:SDRAM_COL_W+2+1];
-wire [SDRAM_BANK_W-1:0] addr_bank_w = addr_i[SDRAM_COL_W+2:SDRAM_COL_W+2-1];
+wire [SDRAM_ROW_W-1:0]  addr_row_w  = (SDRAM_ADDR_MAP == ADDR_MAP_BRC) ?
+                                      addr_i[SDRAM_ADDR_W-SDRAM_BANK_W:SDRAM_COL_W+1] :
+                                      addr_i[SDRAM_ADDR_W:SDRAM_COL_W+SDRAM_BANK_W+1];
+wire [SDRAM_BANK_W-1:0] addr_bank_w = (SDRAM_ADDR_MAP == ADDR_MAP_BRC) ?
+                                      addr_i[SDRAM_ADDR_W:SDRAM_ADDR_W-SDRAM_BANK_W+1] :
+                                      (SDRAM_ADDR_MAP == ADDR_MAP_XOR) ?
+                                      addr_i[SDRAM_COL_W+SDRAM_BANK_W:SDRAM_COL_W+1] ^ addr_row_w[SDRAM_BANK_W-1:0] :
+                                      addr_i[SDRAM_COL_W+SDRAM_BANK_W:SDRAM_COL_W+1];
 wire [SDRAM_MEMS_B+1:0] addr_mem_w = {addr_i[SDRAM_ADDR_W+SDRAM_MEMS_B+1:SDRAM_ADDR_W+1], 1'b0};
 wire [SDRAM_MEMS_B:0]   sel_mem_w = addr_i[SDRAM_ADDR_W+SDRAM_MEMS_B+1:SDRAM_ADDR_W+1];
 reg [SDRAM_MEMS_B:0]    sel_mem_q;
 
+// Free command slots: the NOP clocks of a write burst or of a read waiting
+// for its data (a delay on the way back to idle with a read in flight,
+// which is never the tRFC of a refresh)
+wire la_slot_w = !refresh_q && (la_wait_q == 4'd0) &&
+                 (state_q == STATE_READ_WAIT || state_q == STATE_WRITE1 ||
+                  (state_q == STATE_DELAY && delay_state_q == STATE_IDLE && (|rd_q)));
+wire la_req_w  = la_slot_w && la_held_q && stb_i && cyc_i && (addr_bank_w != cur_bank_q);
+wire la_act_w  = la_req_w && !row_open_q[addr_bank_w];
+wire la_pre_w  = la_req_w && row_open_q[addr_bank_w] &&
+                 (addr_row_w != active_row_q[addr_bank_w]) && !ras_busy_w[addr_bank_w];
+
 //-----------------------------------------------------------------
 // SDRAM State Machine
 //-----------------------------------------------------------------
@@ -191,7 +245,7 @@ begin
     //-----------------------------------------
     STATE_INIT :
     begin
-        if (refresh_q)
+        if (refresh_pend_q != 4'd0)
             next_state_r = STATE_IDLE;
     end
     //-----------------------------------------
@@ -199,14 +253,20 @@ begin
     //-----------------------------------------
     STATE_IDLE :
     begin
+        // tRCD / tRP of a lookahead command still running
+        if (la_wait_q != 4'd0)
+            ;
         // Pending refresh
         // Note: tRAS (open row time) cannot be exceeded due to periodic
         //        auto refreshes.
-        if (refresh_q)
+        else if (refresh_q)
         begin
-            // Close open rows, then refresh
+            // Close open rows (once open for tRAS), then refresh
             if (|row_open_q)
-                next_state_r = STATE_PRECHARGE;
+            begin
+                if (!(|ras_busy_w))
+                    next_state_r = STATE_PRECHARGE;
+            end
             else
                 next_state_r = STATE_REFRESH;
 
@@ -223,10 +283,11 @@ begin
                 else
                     next_state_r = STATE_READ;
             end
-            // Row miss, close row, open new row
+            // Row miss, close row (once open for tRAS), open new row
             else if (row_open_q[addr_bank_w])
             begin
-                next_state_r   = STATE_PRECHARGE;
+                if (!ras_busy_w[addr_bank_w])
+                    next_state_r = STATE_PRECHARGE;
 
                 if (we_i)
                     target_state_r = STATE_WRITE0;
@@ -444,13 +505,28 @@ else if (refresh_timer_q == {REFRESH_CNT_W{1'b0}})
 else
     refresh_timer_q <= refresh_timer_q - 1;
 
+// A refresh that comes due while requests are waiting is postponed, up to
+// SDRAM_REFRESH_POSTPONE of them, so a stream keeps its open rows. The
+// ones owed are issued back to back as soon as the bus goes idle, or one
+// at a time once SDRAM_REFRESH_POSTPONE are owed, before the next comes
+// due, which keeps refreshes at most SDRAM_REFRESH_POSTPONE+1 intervals
+// apart and each within SDRAM_REFRESH_POSTPONE intervals of its own.
+wire       refresh_due_w  = (refresh_timer_q == {REFRESH_CNT_W{1'b0}});
+wire       refresh_done_w = (state_q == STATE_REFRESH);
+wire [3:0] refresh_pend_w = refresh_pend_q + {3'd0, refresh_due_w} - {3'd0, refresh_done_w};
+
+always @ (posedge rst_i or posedge clk_i)
+if (rst_i)
+    refresh_pend_q <= 4'd0;
+else
+    refresh_pend_q <= refresh_pend_w;
+
 always @ (posedge rst_i or posedge clk_i)
 if (rst_i)
     refresh_q <= 1'b0;
-else if (refresh_timer_q == {REFRESH_CNT_W{1'b0}})
-    refresh_q <= 1'b1;
-else if (state_q == STATE_REFRESH)
-    refresh_q <= 1'b0;
+else
+    refresh_q <= (refresh_pend_w != 4'd0) &&
+                 ((refresh_pend_w >= SDRAM_REFRESH_POSTPONE) || !(stb_i && cyc_i));
 
 //-----------------------------------------------------------------
 // Input sampling
@@ -508,6 +584,7 @@ begin
     data_rd_en_q    <= 1'b1;
     dqm_buffer_q    <= {SDRAM_DQM_W{1'b0}};
     sel_mem_q       <= {(SDRAM_MEMS_B+1){1'b0}};
+    cur_bank_q      <= {SDRAM_BANK_W{1'b0}};
 
     for (idx=0;idx<SDRAM_BANKS;idx=idx+1)
         active_row_q[idx] <= {SDRAM_ROW_W{1'b0}};
@@ -628,6 +705,8 @@ begin
         
         // The current selector
         sel_mem_q   <= sel_mem_w;
+
+        cur_bank_q  <= addr_bank_w;
     end
     //-----------------------------------------
     // STATE_WRITE0
@@ -647,6 +726,8 @@ begin
         dqm_buffer_q    <= ~({{(SDRAM_DQM_W-2){1'b0}}, sel_i[3:2]} << addr_mem_w);
 
         data_rd_en_q    <= 1'b0;
+
+        cur_bank_q      <= addr_bank_w;
     end
     //-----------------------------------------
     // STATE_WRITE1
@@ -665,13 +746,76 @@ begin
         dqm_q       <= dqm_buffer_q;
     end
     endcase
+
+    // Lookahead command, in place of the NOP of a free slot
+    if (la_act_w)
+    begin
+        command_q     <= CMD_ACTIVE;
+        addr_q        <= addr_row_w;
+        bank_q        <= addr_bank_w;
+
+        active_row_q[addr_bank_w]  <= addr_row_w;
+        row_open_q[addr_bank_w]    <= 1'b1;
+    end
+    else if (la_pre_w)
+    begin
+        command_q           <= CMD_PRECHARGE;
+        addr_q[ALL_BANKS]   <= 1'b0;
+        bank_q              <= addr_bank_w;
+
+        row_open_q[addr_bank_w] <= 1'b0;
+    end
 end
 
 //-----------------------------------------------------------------
-// Record read events
+// Lookahead timing
 //-----------------------------------------------------------------
-reg [SDRAM_READ_LATENCY+1:0]  rd_q;
+// READ / WRITE no earlier than tRCD after a lookahead ACTIVATE, ACTIVATE
+// or REFRESH no earlier than tRP after a lookahead PRECHARGE. Both wait
+// in STATE_IDLE, which every access after a lookahead goes through.
+always @ (posedge rst_i or posedge clk_i)
+if (rst_i)
+    la_wait_q <= 4'd0;
+else if (la_act_w)
+    la_wait_q <= SDRAM_TRCD_CYCLES;
+else if (la_pre_w)
+    la_wait_q <= SDRAM_TRP_CYCLES;
+else if (la_wait_q != 4'd0)
+    la_wait_q <= la_wait_q - 4'd1;
+
+always @ (posedge rst_i or posedge clk_i)
+if (rst_i)
+    la_held_q <= 1'b0;
+else
+    la_held_q <= stb_i && cyc_i && stall_o;
+
+// No PRECHARGE of a bank until tRAS after its ACTIVATE
+integer ras_idx;
 
+always @ (posedge rst_i or posedge clk_i)
+if (rst_i)
+begin
+    for (ras_idx=0;ras_idx<SDRAM_BANKS;ras_idx=ras_idx+1)
+        ras_q[ras_idx] <= 4'd0;
+end
+else
+begin
+    for (ras_idx=0;ras_idx<SDRAM_BANKS;ras_idx=ras_idx+1)
+        if ((state_q == STATE_ACTIVATE || la_act_w) && addr_bank_w == ras_idx)
+            ras_q[ras_idx] <= SDRAM_TRAS_CYCLES;
+        else if (ras_q[ras_idx] != 4'd0)
+            ras_q[ras_idx] <= ras_q[ras_idx] - 4'd1;
+end
+
+generate
+  for(i = 0; i < SDRAM_BANKS; i=i+1) begin : SDRAM_RAS_BUSY
+    assign ras_busy_w[i] = (ras_q[i] != 4'd0);
+  end
+endgenerate
+
+//-----------------------------------------------------------------
+// Record read events
+//-----------------------------------------------------------------
 always @ (posedge rst_i or posedge clk_i)
 if (rst_i)
     rd_q    <= {(SDRAM_READ_LATENCY+2){1'b0}};
@@ -718,6 +862,29 @@ assign ack_o  = ack_q;
 // Accept wishbone command in READ or WRITE0 states
 assign stall_o = ~(state_q == STATE_READ || state_q == STATE_WRITE0);
 
+//-----------------------------------------------------------------
+// Events
+//-----------------------------------------------------------------
+// A READ or WRITE command is a row miss when it is the first one to its
+// bank since an ACTIVATE, and a row hit otherwise
+reg [SDRAM_BANKS-1:0] act_pend_q;
+
+wire evt_rw_w = (command_q == CMD_READ) || (command_q == CMD_WRITE);
+
+always @ (posedge rst_i or posedge clk_i)
+if (rst_i)
+    act_pend_q <= {SDRAM_BANKS{1'b0}};
+else if (command_q == CMD_ACTIVE)
+    act_pend_q[bank_q] <= 1'b1;
+else if (evt_rw_w)
+    act_pend_q[bank_q] <= 1'b0;
+
+assign evt_read_o     = (command_q == CMD_READ);
+assign evt_write_o    = (command_q == CMD_WRITE);
+assign evt_row_hit_o  = evt_rw_w && !act_pend_q[bank_q];
+assign evt_row_miss_o = evt_rw_w && act_pend_q[bank_q];
+assign evt_refresh_o  = (command_q == CMD_REFRESH);
+
 //-----------------------------------------------------------------
 // SDRAM I/O
 //-----------------------------------------------------------------
@@ -0,0 +1,82 @@
+#ifndef	SDRAMCAPTURE_H
+#define	SDRAMCAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdramsim.h"
+
+// Capture of the command stream going into an SDRAM model
+// (+sdram_capture), for the sdramreplay host tool.
+//
+// The file has a header, a snapshot of the model (SDRAMSIM::save()) at the
+// start of the capture, and then one record per sdram_cycle() call.  The
+// clocks sdramsim.v skipped while the model was idle have no record, the
+// clock numbers tell where they were.  Replaying the records through a
+// model restored from the snapshot reproduces the run: same commands,
+// same read data, same final memory.
+#define	SDRAMCAPTURE_MAGIC	"SDRCAP01"
+
+struct	SDRAMCAPTURE_HDR {
+	char		magic[8];
+	uint32_t	recsize;
+	uint32_t	rsvd;
+	uint64_t	base;
+};
+
+struct	SDRAMCAPTURE_REC {
+	uint64_t	cycle;
+	uint32_t	ctl;	// SDRAM_CTL_*
+	uint32_t	data;
+};
+
+class	SDRAMCAPTURE {
+	FILE	*m_fp;
+	char	*m_buf;
+	static const size_t	BUFSZ = 1<<20;
+
+public:
+	SDRAMCAPTURE(const char *fname, uint64_t base, const SDRAMSIM &sim) {
+		SDRAMCAPTURE_HDR	hdr;
+
+		m_buf = NULL;
+		if (!(m_fp = fopen(fname, "wb"))) {
+			fprintf(stderr, "SDRAM: cannot create capture %s\n", fname);
+			return;
+		}
+		m_buf = new char[BUFSZ];
+		setvbuf(m_fp, m_buf, _IOFBF, BUFSZ);
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, SDRAMCAPTURE_MAGIC, sizeof(hdr.magic));
+		hdr.recsize = sizeof(SDRAMCAPTURE_REC);
+		hdr.base    = base;
+		fwrite(&hdr, sizeof(hdr), 1, m_fp);
+		sim.save(m_fp);
+	}
+
+	~SDRAMCAPTURE(void) {
+		close();
+	}
+
+	bool	ok(void) const { return m_fp != NULL; }
+
+	void	record(uint64_t cycle, unsigned ctl, unsigned data) {
+		SDRAMCAPTURE_REC	r;
+
+		r.cycle = cycle;
+		r.ctl   = ctl;
+		r.data  = data;
+		fwrite(&r, sizeof(r), 1, m_fp);
+	}
+
+	void	close(void) {
+		if (m_fp)
+			fclose(m_fp);
+		m_fp = NULL;
+		delete[] m_buf;
+		m_buf = NULL;
+	}
+};
+
+#endif
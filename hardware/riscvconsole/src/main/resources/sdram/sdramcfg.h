@@ -0,0 +1,93 @@
+#ifndef	SDRAMCFG_H
+#define	SDRAMCFG_H
+
+#include <stdint.h>
+
+// Address mapping of the controller (SDRAM_ADDR_MAP), from the low bits
+// of a lane's word address up: column always, then
+//   SDRAM_MAP_RBC  bank, row                   (the model's own order)
+//   SDRAM_MAP_BRC  row, bank
+//   SDRAM_MAP_XOR  bank XOR the low row bits, row
+#define	SDRAM_MAP_RBC	0
+#define	SDRAM_MAP_BRC	1
+#define	SDRAM_MAP_XOR	2
+#define	SDRAM_NMAPS	3
+
+// Geometry of the simulated part(s), the same parameters the controller
+// takes in sdram_bb_cfg.  A data bus wider than 16 bits is handled as
+// several 16-bit chips side by side (lanes), as the controller does.
+struct	SDRAMCFG {
+	unsigned	data_w;		// DQ width: 16 or 32
+	unsigned	row_w, bank_w, col_w;
+	uint64_t	clk_hz;
+	bool		fast_init;	// no 100uS wait before the init commands
+	unsigned	addr_map;	// SDRAM_MAP_*
+	// Refreshes the controller may postpone (SDRAM_REFRESH_POSTPONE),
+	// each of which delays the next row by one refresh interval
+	unsigned	refresh_postpone;
+
+	SDRAMCFG(void) : data_w(16), row_w(13), bank_w(2), col_w(9),
+		clk_hz(100000000), fast_init(false), addr_map(SDRAM_MAP_RBC),
+		refresh_postpone(8) {}
+	bool	operator==(const SDRAMCFG &o) const {
+		return (data_w == o.data_w)&&(row_w == o.row_w)
+			&&(bank_w == o.bank_w)&&(col_w == o.col_w)
+			&&(clk_hz == o.clk_hz)&&(addr_map == o.addr_map);
+	}
+	unsigned	lanes(void) const { return data_w / 16; }
+	// 16-bit words per lane
+	uint64_t	lanewords(void) const { return 1ull << (row_w+bank_w+col_w); }
+	uint64_t	size(void) const { return lanewords() * 2 * lanes(); }
+
+	// Word w of a lane in bus order to the model's (row, bank, column)
+	// order, and back
+	uint64_t	to_store(uint64_t w) const {
+		uint64_t	col = w & ((1ull << col_w)-1), hi = w >> col_w;
+		uint64_t	bmsk = (1ull << bank_w)-1, row, bank;
+
+		switch(addr_map) {
+		case SDRAM_MAP_BRC:
+			row  = hi & ((1ull << row_w)-1);
+			bank = hi >> row_w;
+			break;
+		case SDRAM_MAP_XOR:
+			row  = hi >> bank_w;
+			bank = (hi ^ row) & bmsk;
+			break;
+		default:
+			return w;
+		}
+		return (((row << bank_w) | bank) << col_w) | col;
+	}
+
+	uint64_t	to_bus(uint64_t w) const {
+		uint64_t	col = w & ((1ull << col_w)-1), hi = w >> col_w;
+		uint64_t	bmsk = (1ull << bank_w)-1;
+		uint64_t	row = hi >> bank_w, bank = hi & bmsk;
+
+		switch(addr_map) {
+		case SDRAM_MAP_BRC:
+			return (((bank << row_w) | row) << col_w) | col;
+		case SDRAM_MAP_XOR:
+			return (((row << bank_w) | ((bank ^ row) & bmsk)) << col_w) | col;
+		default:
+			return w;
+		}
+	}
+
+	// Byte offset of the bus into the store, and back (lanes stay where
+	// they are, see SDRAMSIM)
+	uint64_t	store_offset(uint64_t off) const {
+		uint64_t	lane = off & ~(lanewords()*2 - 1);
+
+		return lane | (to_store((off - lane) >> 1) << 1) | (off & 1);
+	}
+
+	uint64_t	bus_offset(uint64_t off) const {
+		uint64_t	lane = off & ~(lanewords()*2 - 1);
+
+		return lane | (to_bus((off - lane) >> 1) << 1) | (off & 1);
+	}
+};
+
+#endif
@@ -0,0 +1,70 @@
+//VCS coverage exclude_file
+// Functional (untimed) access to the SDRAM model's memory, for the
+// simulation-only fast mode of the SDRAM TileLink port.  The memory is
+// the one sdramsim.v instances keep, found by address.
+import "DPI-C" function int sdram_func_init
+(
+ input longint base
+);
+
+// Returns the mode the port is to run in from the next clock on (1:
+// functional), only ever changing it while idle is set
+import "DPI-C" function int sdram_func_mode
+(
+ input int handle,
+ input longint cycle,
+ input int idle
+);
+
+import "DPI-C" function int sdram_func_access
+(
+ input int handle,
+ input longint addr,
+ input int we,
+ input int mask,
+ input int wdata,
+ output int rdata
+);
+
+module sdramfunc #(
+  parameter    SDRAM_BASE            = 64'h0
+) (
+  input              clock,
+  input              reset,
+  input              req,
+  input              we,
+  input      [31:0]  addr,
+  input      [3:0]   mask,
+  input      [31:0]  wdata,
+  input              idle,
+  output reg         ack,
+  output reg [31:0]  rdata,
+  output reg         functional
+);
+
+  int __func;
+  longint __cycle;
+  int __rdata;
+  int __ret;
+
+  initial begin
+    __func = sdram_func_init(SDRAM_BASE);
+    __cycle = 0;
+  end
+
+  always @(posedge clock)
+    if(reset) begin
+      ack <= 1'b0;
+      functional <= sdram_func_mode(__func, 0, 1) != 0;
+    end else begin
+      __cycle = __cycle + 1;
+      ack <= 1'b0;
+      if(functional && req) begin
+        __ret = sdram_func_access(__func, {32'd0, addr}, {31'd0, we}, {28'd0, mask}, wdata, __rdata);
+        rdata <= __rdata;
+        ack <= 1'b1;
+      end
+      functional <= sdram_func_mode(__func, __cycle, {31'd0, idle}) != 0;
+    end
+
+endmodule
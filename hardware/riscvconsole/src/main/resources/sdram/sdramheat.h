@@ -0,0 +1,139 @@
+#ifndef	SDRAMHEAT_H
+#define	SDRAMHEAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "sdramcfg.h"
+
+// Where the SDRAM traffic goes: data beats per page (read and write) and
+// activates per bank and row, to be joined against the ELF symbols of the
+// program.  Pages are SDRAMHEAT_PAGE bytes of the bus address space.  A
+// beat counts once for every lane it reads or writes, against the page
+// holding that lane's bytes.
+//
+// Written out as two CSV files, with absolute addresses:
+//   <file>       address,reads,writes,activates  (touched pages only)
+//   <file>.rows  address,bank,row,activates      (activated rows only)
+// A row is counted in the page of its column 0, and listed at that
+// address.
+#define	SDRAMHEAT_PAGE_BITS	12
+#define	SDRAMHEAT_PAGE		(1u << SDRAMHEAT_PAGE_BITS)
+
+class	SDRAMHEAT {
+	SDRAMCFG	m_cfg;
+	int		m_lanes, m_row_w, m_bank_w, m_col_w;
+	uint64_t	m_lanewords;
+	std::vector<uint64_t>	m_rd, m_wr;	// per page
+	std::vector<uint32_t>	m_act;		// per bank, row
+
+	// Page of lane l of 16-bit word w, in bus order (lanes are stored one
+	// after the other, see SDRAMSIM)
+	uint64_t	page(int l, uint64_t w) const {
+		return ((l*m_lanewords + w) * 2) >> SDRAMHEAT_PAGE_BITS;
+	}
+
+	// Bus byte offset of column 0 of a row
+	uint64_t	row_offset(unsigned bank, unsigned row) const {
+		return m_cfg.to_bus((((uint64_t)row << m_bank_w) | bank) << m_col_w) * 2;
+	}
+public:
+	SDRAMHEAT(const SDRAMCFG &cfg) {
+		m_cfg    = cfg;
+		m_lanes  = cfg.lanes();
+		m_row_w  = cfg.row_w;
+		m_bank_w = cfg.bank_w;
+		m_col_w  = cfg.col_w;
+		m_lanewords = cfg.lanewords();
+		m_rd.assign((m_lanewords * 2 * m_lanes) >> SDRAMHEAT_PAGE_BITS, 0);
+		m_wr.assign(m_rd.size(), 0);
+		m_act.assign((size_t)1 << (m_bank_w + m_row_w), 0);
+	}
+
+	// A beat read from / written to word address w, in the model's order
+	void	read(uint64_t w) {
+		w = m_cfg.to_bus(w);
+		for(int l=0; l<m_lanes; l++)
+			m_rd[page(l, w)]++;
+	}
+
+	void	write(uint64_t w, unsigned dqm) {
+		w = m_cfg.to_bus(w);
+		for(int l=0; l<m_lanes; l++, dqm >>= 2)
+			if ((dqm&3) != 3)
+				m_wr[page(l, w)]++;
+	}
+
+	void	act(unsigned bank, unsigned row) {
+		m_act[((size_t)bank << m_row_w) + row]++;
+	}
+
+	bool	save(const char *fname, uint64_t base) const {
+		std::vector<uint64_t>	pact(m_rd.size(), 0);
+		std::string	rname = std::string(fname) + ".rows";
+		FILE		*fp;
+
+		if (!(fp = fopen(rname.c_str(), "w")))
+			return false;
+		fprintf(fp, "address,bank,row,activates\n");
+		for(unsigned row=0; row < (1u << m_row_w); row++)
+		for(unsigned bank=0; bank < (1u << m_bank_w); bank++) {
+			uint32_t	n = m_act[((size_t)bank << m_row_w) + row];
+			uint64_t	off = row_offset(bank, row);
+
+			if (n == 0)
+				continue;
+			pact[off >> SDRAMHEAT_PAGE_BITS] += n;
+			fprintf(fp, "0x%08lx,%u,%u,%u\n", (unsigned long)(base + off),
+				bank, row, n);
+		}
+		fclose(fp);
+
+		if (!(fp = fopen(fname, "w")))
+			return false;
+		fprintf(fp, "address,reads,writes,activates\n");
+		for(size_t p=0; p<m_rd.size(); p++) {
+			if ((m_rd[p] == 0)&&(m_wr[p] == 0)&&(pact[p] == 0))
+				continue;
+			fprintf(fp, "0x%08lx,%lu,%lu,%lu\n",
+				(unsigned long)(base + (p << SDRAMHEAT_PAGE_BITS)),
+				(unsigned long)m_rd[p], (unsigned long)m_wr[p],
+				(unsigned long)pact[p]);
+		}
+		fclose(fp);
+		return true;
+	}
+
+	// Working set: pages touched, and how few of them take 50/90/99% of
+	// the beats
+	void	summary(FILE *fp, const char *name) const {
+		std::vector<uint64_t>	beats;
+		uint64_t	total = 0, acc = 0;
+		const int	pct[] = { 50, 90, 99 };
+		unsigned	k = 0;
+
+		for(size_t p=0; p<m_rd.size(); p++)
+			if (m_rd[p] + m_wr[p]) {
+				beats.push_back(m_rd[p] + m_wr[p]);
+				total += beats.back();
+			}
+		if (total == 0)
+			return;
+		std::sort(beats.begin(), beats.end(), std::greater<uint64_t>());
+		fprintf(fp, "%s working set: %zu pages (%zu KB) touched", name,
+			beats.size(), beats.size() * (SDRAMHEAT_PAGE >> 10));
+		for(size_t i=0; (i<beats.size())&&(k < 3); i++) {
+			acc += beats[i];
+			while((k < 3)&&(acc * 100 >= total * pct[k]))
+				fprintf(fp, ", %d%% in %zu KB", pct[k++],
+					(i+1) * (SDRAMHEAT_PAGE >> 10));
+		}
+		fprintf(fp, "\n");
+	}
+};
+
+#endif
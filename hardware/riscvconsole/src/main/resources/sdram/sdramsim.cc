@@ -1,9 +1,126 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "sdramsim.h"
 
+void	SDRAMSIM::set_mode(unsigned mode) {
+	static const int	bl[8] = { 1, 2, 4, 8, 0, 0, 0, -1 };
+
+	if (m_trace)
+		m_trace->record(m_tick, SDRAMTRACE_MODE, 0, mode);
+
+	m_mode = mode;
+	m_bl   = bl[mode & 7];
+	m_interleave = (mode & 0x08) != 0;
+	m_cl   = (mode >> 4) & 7;
+	m_wb_single = (mode & 0x0200) != 0;
+
+	printf("Mode set: %08x (BL %d, %s, CL %d%s)\n", mode, m_bl,
+		(m_interleave) ? "interleaved" : "sequential", m_cl,
+		(m_wb_single) ? ", single writes" : "");
+	if (m_bl == 0) {
+		fprintf(stderr, "ERR: Reserved burst length in mode %03x\n", mode);
+		assert(0 && "Reserved burst length");
+	}
+	if ((m_bl < 0)&&(m_interleave)) {
+		fprintf(stderr, "ERR: Full page bursts must be sequential (mode %03x)\n", mode);
+		assert(0 && "Interleaved full page burst");
+	}
+	if ((m_cl < 1)||(m_cl > 3)) {
+		fprintf(stderr, "ERR: Unsupported CAS latency in mode %03x\n", mode);
+		assert(0 && "Unsupported CAS latency");
+	}
+	if (mode & 0x0180) {
+		fprintf(stderr, "ERR: Reserved operating mode in mode %03x\n", mode);
+		assert(0 && "Reserved operating mode");
+	}
+}
+
+// Column of beat "beat" of a burst starting at column "col"
+unsigned	SDRAMSIM::burst_col(unsigned col, unsigned beat) const {
+	unsigned	msk;
+
+	if (m_bl < 0) // Full page, wraps around the row
+		return (col + beat) & m_colmsk;
+	msk = m_bl - 1;
+	if (m_interleave)
+		return (col & ~msk) | ((col ^ beat) & msk);
+	return (col & ~msk) | ((col + beat) & msk);
+}
+
+// Longest PRE to ACT gap (tRP plus slack) for the PRE to be counted as
+// part of the access in the read latency
+#define	PRE_ACT_WINDOW	4
+
+// A bank is being precharged: check it was activated at least tRAS ago,
+// and remember the row it had open
+void	SDRAMSIM::close_bank(int bs) {
+	uint64_t	act = m_bank_open_deadline[bs] - m_max_bankopen;
+
+	if ((m_bank_status[bs]&4)&&(m_tick < act + m_min_ras)) {
+		fprintf(stderr, "ERR: Bank %d precharged %lu clocks after its ACTIVATE, tRAS is %d\n",
+			bs, (unsigned long)(m_tick - act), m_min_ras);
+		assert(0 && "tRAS violation");
+	}
+	if (m_bank_status[bs]&1) {
+		m_bank_closed[bs] = true;
+		m_bank_closed_row[bs] = m_bank_row[bs];
+	}
+}
+
+// Catch up with n NOP clocks nobody called us for.  Only the bank status
+// pipeline and the counters need it: the refresh and bank open limits are
+// absolute clocks, and the read queue is empty while idle.
+void	SDRAMSIM::skip(uint64_t n) {
+	bool	settled = false;
+	int	busy = 0;
+
+	// A bank's status settles (open or closed) within two clocks
+	for(; (n > 0)&&(!settled); n--) {
+		m_tick++;
+		m_qloc = (m_qloc + 1)&m_qmask;
+		m_stats.inc(SDRAMSTAT_TICKS);
+		m_stats.inc(SDRAMSTAT_NOP);
+		busy = 0;
+		settled = true;
+		for(int i=0; i<m_nbanks; i++) {
+			m_bank_status[i] >>= 1;
+			if (m_bank_status[i]&2)
+				m_bank_status[i] |= 4;
+			busy |= m_bank_status[i];
+			if ((m_bank_status[i] != 0)&&(m_bank_status[i] != 7))
+				settled = false;
+		}
+		if (!busy)
+			m_stats.inc(SDRAMSTAT_IDLE);
+	}
+
+	// From then on every clock looks the same
+	m_tick += n;
+	m_qloc = (m_qloc + n)&m_qmask;
+	m_stats.add(SDRAMSTAT_TICKS, n);
+	m_stats.add(SDRAMSTAT_NOP, n);
+	if (!busy)
+		m_stats.add(SDRAMSTAT_IDLE, n);
+}
+
+int	SDRAMSIM::cycle(uint64_t cycle, unsigned ctl, int data) {
+	if (cycle <= m_tick) {
+		fprintf(stderr, "ERR: SDRAM clock %lu after clock %lu (restored the SDRAM but not the RTL?)\n",
+			(unsigned long)cycle, (unsigned long)m_tick);
+		assert(0 && "SDRAM clock went backwards");
+	} else if (cycle > m_tick+1) {
+		assert(idle());
+		skip(cycle - m_tick - 1);
+	}
+	return (*this)(1, SDRAM_CTL_CKE(ctl), SDRAM_CTL_CS_N(ctl),
+		SDRAM_CTL_RAS_N(ctl), SDRAM_CTL_CAS_N(ctl), SDRAM_CTL_WE_N(ctl),
+		SDRAM_CTL_BS(ctl), SDRAM_CTL_ADDR(ctl), SDRAM_CTL_DRIV(ctl),
+		data, SDRAM_CTL_DQM(ctl));
+}
+
 int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int we_n,
 		int bs, unsigned addr, int driv, int data, int dqm) {
 	int	result = 0;
@@ -22,6 +139,8 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 		//assert(cke);
 	}
 
+	m_tick++;
+
 	if (m_pwrup < POWERED_UP_STATE) {
 		//assert(dqm == 3); ISSI: This does not matter
 		if (m_clocks_till_idle > 0)
@@ -40,7 +159,7 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 				m_clocks_till_idle = 3; // tRP, 3 cycles
 				
 				// Bank/Precharge All CMD
-				for(int i=0; i<NBANKS; i++)
+				for(int i=0; i<m_nbanks; i++)
 					m_bank_status[i] &= 0x03;
 			}
 		} else if (m_pwrup == 2) {
@@ -51,7 +170,7 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 					printf("Successful 1st auto-refresh, waiting for 2nd\n");
 					m_clocks_till_idle = 9; // tRC, 9 cycles
 					for(int i=0; i<m_nrefresh; i++)
-						m_refresh_time[i] = MAX_REFRESH_TIME;
+						m_refresh_time[i] = m_tick + m_max_refresh;
 				}
 			} else
 				assert((ras_n)&&(cas_n)&&(we_n));
@@ -63,7 +182,7 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 					printf("Successful 2nd auto-refresh, waiting for mode-set\n");
 					m_clocks_till_idle = 9; // tRC, 9 cycles
 					for(int i=0; i<m_nrefresh; i++)
-						m_refresh_time[i] = MAX_REFRESH_TIME;
+						m_refresh_time[i] = m_tick + m_max_refresh;
 				}
 			} else
 				assert((ras_n)&&(cas_n)&&(we_n));
@@ -71,8 +190,7 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 			if (m_clocks_till_idle == 0) {
 				if ((!cs_n)&&(!ras_n)&&(!cas_n)&&(!we_n)){
 					// mode set
-					printf("Mode set: %08x\n", addr);
-					assert(addr == 0x021);
+					set_mode(addr);
 					m_pwrup++;
 					printf("Successful mode set, moving to state #3\n");
 					m_clocks_till_idle=2; // tMRD, 2 cycles
@@ -88,31 +206,26 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 				;
 			} else assert(0 && "Should never get here!");
 		} 
-		m_next_wr = false;
+		m_rd_left = m_wr_left = 0;
 	} else { // In operation ...
-		
-		for(int i=0; i<m_nrefresh; i++)
-			m_refresh_time[i]--;
+		int	busy = 0;
 
-		if (m_refresh_time[m_refresh_loc] < 0) {
+		m_stats.inc(SDRAMSTAT_TICKS);
+		if (m_tick > m_refresh_time[m_refresh_loc]) {
+			fprintf(stderr, "ERR: Row %d not refreshed in time (tick %lu)\n",
+				m_refresh_loc, (unsigned long)m_tick);
 			assert(0 && "Failed refresh requirement");
-		} 
+		}
 		
-		for(int i=0; i<NBANKS; i++) {
+		for(int i=0; i<m_nbanks; i++) {
 			m_bank_status[i] >>= 1;
 			if (m_bank_status[i]&2)
 				m_bank_status[i] |= 4;
-			if (m_bank_status[i]&1) { // Bank is open
-				m_bank_open_time[i] --;
-				if (m_bank_open_time[i] < 0) {
-					assert(0 && "Bank held open too long");
-				}
-			}
+			busy |= m_bank_status[i];
+			if ((m_bank_status[i]&1)&&(m_tick > m_bank_open_deadline[i]))
+				assert(0 && "Bank held open too long");
 		}
 
-		if (m_clocks_till_idle)
-			m_clocks_till_idle--;
-
 		if (m_fail > 0) {
 			m_fail--;
 			if (m_fail == 0) {
@@ -121,22 +234,6 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 			}
 		}
 
-		if ((m_clocks_till_idle > 0)&&(m_next_wr)) {
-			printf("SDRAM[%08x] <= %04x\n", m_wr_addr, data & 0x0ffff);
-			int	waddr = m_wr_addr++, memval;
-			memval = m_mem[waddr];
-			if ((dqm&3)==0)
-				memval = data;
-			else if ((dqm&3)==3)
-				;
-			else if ((dqm&2)==0)
-				memval = (memval & 0x000ff) | (data & 0x0ff00);
-			else // if ((dqm&1)==0)
-				memval = (memval & 0x0ff00) | (data & 0x000ff);
-			m_mem[waddr] = memval;
-			result = data;
-			m_next_wr = false;
-		}
 		m_qloc = (m_qloc + 1)&m_qmask;
 		result = (driv)?data:m_qdata[(m_qloc)&m_qmask];
 		m_qdata[(m_qloc)&m_qmask] = 0;
@@ -146,32 +243,51 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 
 		if ((!cs_n)&&(!ras_n)&&(!cas_n)&&(we_n)) {
 			// Auto-refresh command
-			m_refresh_time[m_refresh_loc] = MAX_REFRESH_TIME;
+			if (m_trace)
+				m_trace->record(m_tick, SDRAMTRACE_REF, 0, 0);
+			m_stats.inc(SDRAMSTAT_REFRESH);
+			for(int i=0; i<m_nbanks; i++) {
+				m_bank_closed[i] = false;
+				m_bank_req[i] = 0;
+			}
+			m_refresh_time[m_refresh_loc] = m_tick + m_max_refresh;
 			m_refresh_loc++;
 			if (m_refresh_loc >= m_nrefresh)
 				m_refresh_loc = 0;
-			assert((m_bank_status[0]&6) == 0);
-			assert((m_bank_status[1]&6) == 0);
-			assert((m_bank_status[2]&6) == 0);
-			assert((m_bank_status[3]&6) == 0);
+			for(int i=0; i<m_nbanks; i++)
+				assert((m_bank_status[i]&6) == 0);
 		} else if ((!cs_n)&&(!ras_n)&&(cas_n)&&(!we_n)) {
 			if (addr&0x0400) {
 				// Bank/Precharge All CMD
-				for(int i=0; i<NBANKS; i++)
+				if (m_trace)
+					m_trace->record(m_tick, SDRAMTRACE_PREALL, 0, 0);
+				for(int i=0; i<m_nbanks; i++) {
+					close_bank(i);
 					m_bank_status[i] &= 0x03;
+				}
+				m_rd_left = m_wr_left = 0;
 			} else {
 				// Precharge/close single bank
-				assert(0 == (bs & (~3))); // Assert w/in bounds
+				assert(bs < m_nbanks); // Assert w/in bounds
+				if (m_trace)
+					m_trace->record(m_tick, SDRAMTRACE_PRE, bs, 0);
+				close_bank(bs);
+				if (!m_bank_req[bs])
+					m_bank_req[bs] = m_tick;
 				m_bank_status[bs] &= 0x03; // Close the bank
+				if (m_rd_bank == bs)
+					m_rd_left = 0;
+				if (m_wr_bank == bs)
+					m_wr_left = 0;
 
 				// printf("Precharging bank %d\n", bs);
 			}
 		} else if ((!cs_n)&&(!ras_n)&&(cas_n)&&(we_n)) {
 			// printf("Activating bank %d\n", bs);
 			// Activate a bank!
-			if (0 != (bs & (~3))) {
+			if (bs >= m_nbanks) {
 				m_fail = 2;
-				fprintf(stderr, "ERR: Activating a bank w/ more than 2 bits\n");
+				fprintf(stderr, "ERR: Activating bank %d of %d\n", bs, m_nbanks);
 				// assert(0 == (bs & (~3))); // Assert w/in bounds
 			} else if (m_bank_status[bs] != 0) {
 				fprintf(stderr, "ERR: Status of bank [bs=%d] = %d != 0\n",
@@ -180,63 +296,88 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 				// assert(m_bank_status[bs]==0); // Assert bank was closed
 			}
 			m_bank_status[bs] |= 4;
-			m_bank_open_time[bs] = MAX_BANKOPEN_TIME;
-			m_bank_row[bs] = addr;
+			m_bank_open_deadline[bs] = m_tick + m_max_bankopen;
+			m_bank_row[bs] = addr & m_rowmsk;
+			if (m_trace)
+				m_trace->record(m_tick, SDRAMTRACE_ACT, bs, addr);
+			if (bs < m_nbanks) {
+				m_stats.inc(SDRAMSTAT_ACTS);
+				m_stats.inc(SDRAMSTAT_ACT + bs);
+				if (m_heat)
+					m_heat->act(bs, m_bank_row[bs]);
+				m_bank_used[bs] = false;
+				m_bank_conflict[bs] = (m_bank_closed[bs])
+					&&(m_bank_closed_row[bs] != m_bank_row[bs]);
+				m_bank_closed[bs] = false;
+				// A precharge long before this is the end of an
+				// earlier access, not the start of this one
+				if ((!m_bank_req[bs])||(m_tick - m_bank_req[bs] > PRE_ACT_WINDOW))
+					m_bank_req[bs] = m_tick;
+			}
 		} else if ((!cs_n)&&(ras_n)&&(!cas_n)) {
-			printf("R/W Op\n");
-			if (!we_n) {
-				// Initiate a write
-				assert(0 == (bs & (~3))); // Assert w/in bounds
-				assert(m_bank_status[bs]&1); // Assert bank is open
+			assert(bs < m_nbanks); // Assert w/in bounds
+			assert(m_bank_status[bs]&1); // Assert bank is open
+
+			unsigned	base;
+
+			// Word address of column 0 of the open row
+			base = m_bank_row[bs];
+			base <<= m_cfg.bank_w;
+			base |= bs;
+			base <<= m_cfg.col_w;
 
-				m_wr_addr = m_bank_row[bs];
-				m_wr_addr <<= 2;
-				m_wr_addr |= bs;
-				m_wr_addr <<= 9;
-				m_wr_addr |= (addr & 0x01ff);
+			if (m_bank_used[bs])
+				m_stats.inc(SDRAMSTAT_ROW_HIT);
+			else if (m_bank_conflict[bs])
+				m_stats.inc(SDRAMSTAT_ROW_CONFLICT);
+			else
+				m_stats.inc(SDRAMSTAT_ROW_MISS);
+			m_bank_used[bs] = true;
 
+			// A new read or write ends any burst in progress
+			m_rd_left = m_wr_left = 0;
+			if (!we_n) {
+				// Initiate a write, the first beat is this cycle
 				assert(driv);
-				printf("SDRAM[%08x] <= %04x\n", m_wr_addr, data & 0x0ffff);
-				m_mem[m_wr_addr++] = data;
-				m_clocks_till_idle = 2;
-				m_next_wr = true;
-
-				if (addr & 0x0400) { // Auto precharge
-					m_bank_status[bs] &= 3;
-					m_bank_open_time[bs] = MAX_BANKOPEN_TIME;
-				}
+				m_wr_bank = bs;
+				m_wr_base = base;
+				m_wr_col  = addr & m_colmsk;
+				m_wr_beat = 0;
+				m_wr_left = (m_wb_single) ? 1 : m_bl;
+				m_stats.inc(SDRAMSTAT_WRITES);
 			} else { // Initiate a read
-				assert(0 == (bs & (~3))); // Assert w/in bounds
-				assert(m_bank_status[bs]&1); // Assert bank is open
-
-				unsigned	rd_addr;
+				assert(!driv);
+				m_rd_bank = bs;
+				m_rd_base = base;
+				m_rd_col  = addr & m_colmsk;
+				m_rd_beat = 0;
+				m_rd_left = m_bl;
+				m_stats.inc(SDRAMSTAT_READS);
+				// First beat shows up CL+1 clocks from now
+				m_stats.rdlat(m_tick + m_cl + 1
+					- ((m_bank_req[bs]) ? m_bank_req[bs] : m_tick));
+			}
 
-				rd_addr = m_bank_row[bs] & 0x01fff;
-				rd_addr <<= 2;
-				rd_addr |= bs;
-				rd_addr <<= 9;
-				rd_addr |= (addr & 0x01ff);
+			m_bank_req[bs] = 0;
 
-				assert(!driv);
-				printf("SDRAM.Q[%2d] %04x <= SDRAM[%08x]\n",
-					(m_qloc+3)&m_qmask,
-					m_mem[rd_addr] & 0x0ffff, rd_addr);
-				m_qdata[(m_qloc+3)&m_qmask] = m_mem[rd_addr++];
-				printf("SDRAM.Q[%2d] %04x <= SDRAM[%08x]\n",
-					(m_qloc+4)&m_qmask,
-					m_mem[rd_addr] & 0x0ffff, rd_addr);
-				m_qdata[(m_qloc+4)&m_qmask] = m_mem[rd_addr++];
-				m_clocks_till_idle = 2;
-
-				if (addr & 0x0400) { // Auto precharge
-					m_bank_status[bs] &= 3;
-					m_bank_open_time[bs] = MAX_BANKOPEN_TIME;
-				}
+			if (addr & 0x0400) { // Auto precharge
+				close_bank(bs);
+				m_bank_status[bs] &= 3;
+				m_bank_open_deadline[bs] = m_tick + m_max_bankopen;
 			}
-		} else if (cs_n) {
-			// Chips not asserted, DESELECT CMD equivalent of a NOOP
-		} else if ((ras_n)&&(cas_n)&&(we_n)) {
-			// NOOP command
+		} else if ((!cs_n)&&(ras_n)&&(cas_n)&&(!we_n)) {
+			// Burst terminate
+			m_rd_left = m_wr_left = 0;
+		} else if ((!cs_n)&&(!ras_n)&&(!cas_n)&&(!we_n)) {
+			// Load mode register, all banks must be idle
+			for(int i=0; i<m_nbanks; i++)
+				assert((m_bank_status[i]&6) == 0);
+			set_mode(addr);
+		} else if ((cs_n)||((ras_n)&&(cas_n)&&(we_n))) {
+			// NOOP, or chips not asserted: DESELECT, equivalent of a NOOP
+			m_stats.inc(SDRAMSTAT_NOP);
+			if ((!busy)&&(!m_rd_left)&&(!m_wr_left))
+				m_stats.inc(SDRAMSTAT_IDLE);
 		} else {
 			fprintf(stderr, "Unrecognized memory command!\n");
 			fprintf(stderr, "\tCS_n  = %d\n", cs_n);
@@ -245,23 +386,187 @@ int	SDRAMSIM::operator()(int clk, int cke, int cs_n, int ras_n, int cas_n, int w
 			fprintf(stderr, "\tWE_n  = %d\n", we_n);
 			assert(0 && "Unrecognizned command");
 		}
+
+		// Burst data for this cycle
+		if (m_wr_left) {
+			unsigned	waddr = m_wr_base | burst_col(m_wr_col, m_wr_beat);
+
+			if (m_trace)
+				m_trace->record(m_tick, SDRAMTRACE_WR, m_wr_bank, waddr, data & m_datamsk, dqm);
+			write_word(waddr, data, dqm);
+			if (m_heat)
+				m_heat->write(waddr, dqm);
+			m_stats.inc(SDRAMSTAT_WR_BEATS);
+			m_wr_beat++;
+			if (m_wr_left > 0)
+				m_wr_left--;
+		}
+
+		if (m_rd_left) {
+			// Data shows up CL cycles after the command, plus one
+			// since we are called on the opposite edge
+			unsigned	raddr = m_rd_base | burst_col(m_rd_col, m_rd_beat);
+
+			m_qdata[(m_qloc+m_cl+1)&m_qmask] = read_word(raddr);
+			m_qlast = m_tick + m_cl + 1;
+			m_stats.inc(SDRAMSTAT_RD_BEATS);
+			if (m_heat)
+				m_heat->read(raddr);
+			if (m_trace)
+				m_trace->record(m_tick, SDRAMTRACE_RD, m_rd_bank, raddr, read_word(raddr));
+			m_rd_beat++;
+			if (m_rd_left > 0)
+				m_rd_left--;
+		}
 	}
 
-	return result & 0x0ffff;
+	return result & m_datamsk;
 }
 
-SDRAMSIM* sdram = NULL;
+//-----------------------------------------------------------------
+// Snapshots
+//-----------------------------------------------------------------
 
-extern "C" int sdram_tick(int clk, int cke, int cs_n, int ras_n, int cas_n, int we_n,
-		int bs, int addr, int driv, int data, int dqm, int* datao)
+template <class T> static void put(FILE *fp, const T &v)
 {
-	if(!sdram) {
-		sdram = new SDRAMSIM();
-	}
-	*datao = (int)(*sdram)(clk, cke, cs_n, ras_n, cas_n, we_n,
-		bs, (unsigned) addr, driv, (int)data, (int)dqm);
-	return 0;
+	fwrite(&v, sizeof(v), 1, fp);
+}
+
+template <class T> static bool get(FILE *fp, T &v)
+{
+	return fread(&v, sizeof(v), 1, fp) == 1;
 }
 
+bool	SDRAMSIM::snapshot_cfg(FILE *fp, SDRAMCFG *cfg) {
+	char		magic[8];
+	uint32_t	v[5];
+	uint64_t	hz;
+	long		pos = ftell(fp);
+	bool		ok;
 
+	ok = (fread(magic, sizeof(magic), 1, fp) == 1)
+		&&(memcmp(magic, SDRAM_SNAPSHOT_MAGIC, sizeof(magic)) == 0)
+		&&(get(fp, v))&&(get(fp, hz));
+	fseek(fp, pos, SEEK_SET);
+	if (!ok)
+		return false;
+	cfg->data_w = v[0];
+	cfg->row_w  = v[1];
+	cfg->bank_w = v[2];
+	cfg->col_w  = v[3];
+	cfg->addr_map = v[4];
+	cfg->clk_hz = hz;
+	return true;
+}
+
+void	SDRAMSIM::save(FILE *fp) const {
+	uint32_t	v[5] = { m_cfg.data_w, m_cfg.row_w, m_cfg.bank_w, m_cfg.col_w,
+		m_cfg.addr_map };
+
+	fwrite(SDRAM_SNAPSHOT_MAGIC, 8, 1, fp);
+	put(fp, v);
+	put(fp, m_cfg.clk_hz);
 
+	put(fp, m_pwrup);
+	put(fp, m_last_value);
+	put(fp, m_bank_status);
+	put(fp, m_bank_row);
+	put(fp, m_bank_open_deadline);
+	put(fp, m_bank_used);
+	put(fp, m_bank_conflict);
+	put(fp, m_bank_closed);
+	put(fp, m_bank_closed_row);
+	put(fp, m_bank_req);
+	put(fp, m_stats);
+	put(fp, m_tick);
+	fwrite(m_refresh_time, sizeof(m_refresh_time[0]), m_nrefresh, fp);
+	put(fp, m_refresh_loc);
+	put(fp, m_qloc);
+	put(fp, m_qdata);
+	put(fp, m_qlast);
+	put(fp, m_clocks_till_idle);
+	put(fp, m_mode); put(fp, m_bl); put(fp, m_cl);
+	put(fp, m_interleave); put(fp, m_wb_single);
+	put(fp, m_fail);
+	put(fp, m_rd_left); put(fp, m_rd_bank); put(fp, m_rd_beat);
+	put(fp, m_rd_base); put(fp, m_rd_col);
+	put(fp, m_wr_left); put(fp, m_wr_bank); put(fp, m_wr_beat);
+	put(fp, m_wr_base); put(fp, m_wr_col);
+
+	m_mem->save(fp);
+}
+
+bool	SDRAMSIM::restore(FILE *fp, bool state) {
+	SDRAMCFG	cfg;
+	uint32_t	v[5];
+	uint64_t	hz;
+	char		magic[8];
+	bool		ok;
+
+	if ((!snapshot_cfg(fp, &cfg))||(!(cfg == m_cfg)))
+		return false;
+	// Read the whole snapshot into a model nobody uses, and only take it
+	// over once all of it has been read
+	SDRAMSIM	scratch(m_cfg, m_mem->huge());
+	SDRAMSTORE	*mem;
+
+	ok = (fread(magic, sizeof(magic), 1, fp) == 1)&&(get(fp, v))&&(get(fp, hz))
+		&&(scratch.restore_state(fp))&&(scratch.m_mem->restore(fp));
+	if (!ok) {
+		fprintf(stderr, "SDRAM: truncated or corrupt snapshot\n");
+		return false;
+	}
+	mem = m_mem;
+	m_mem = scratch.m_mem;
+	scratch.m_mem = mem;
+	if (state)
+		copy_state(scratch);
+	return true;
+}
+
+void	SDRAMSIM::copy_state(const SDRAMSIM &s) {
+	m_pwrup = s.m_pwrup;
+	m_last_value = s.m_last_value;
+	memcpy(m_bank_status, s.m_bank_status, sizeof(m_bank_status));
+	memcpy(m_bank_row, s.m_bank_row, sizeof(m_bank_row));
+	memcpy(m_bank_open_deadline, s.m_bank_open_deadline, sizeof(m_bank_open_deadline));
+	memcpy(m_bank_used, s.m_bank_used, sizeof(m_bank_used));
+	memcpy(m_bank_conflict, s.m_bank_conflict, sizeof(m_bank_conflict));
+	memcpy(m_bank_closed, s.m_bank_closed, sizeof(m_bank_closed));
+	memcpy(m_bank_closed_row, s.m_bank_closed_row, sizeof(m_bank_closed_row));
+	memcpy(m_bank_req, s.m_bank_req, sizeof(m_bank_req));
+	m_stats = s.m_stats;
+	m_tick = s.m_tick;
+	memcpy(m_refresh_time, s.m_refresh_time, sizeof(m_refresh_time[0]) * m_nrefresh);
+	m_refresh_loc = s.m_refresh_loc;
+	m_qloc = s.m_qloc;
+	memcpy(m_qdata, s.m_qdata, sizeof(m_qdata));
+	m_qlast = s.m_qlast;
+	m_clocks_till_idle = s.m_clocks_till_idle;
+	m_mode = s.m_mode; m_bl = s.m_bl; m_cl = s.m_cl;
+	m_interleave = s.m_interleave; m_wb_single = s.m_wb_single;
+	m_fail = s.m_fail;
+	m_rd_left = s.m_rd_left; m_rd_bank = s.m_rd_bank; m_rd_beat = s.m_rd_beat;
+	m_rd_base = s.m_rd_base; m_rd_col = s.m_rd_col;
+	m_wr_left = s.m_wr_left; m_wr_bank = s.m_wr_bank; m_wr_beat = s.m_wr_beat;
+	m_wr_base = s.m_wr_base; m_wr_col = s.m_wr_col;
+}
+
+bool	SDRAMSIM::restore_state(FILE *fp) {
+	return get(fp, m_pwrup) && get(fp, m_last_value)
+		&& get(fp, m_bank_status) && get(fp, m_bank_row)
+		&& get(fp, m_bank_open_deadline) && get(fp, m_bank_used)
+		&& get(fp, m_bank_conflict) && get(fp, m_bank_closed)
+		&& get(fp, m_bank_closed_row) && get(fp, m_bank_req)
+		&& get(fp, m_stats) && get(fp, m_tick)
+		&& (fread(m_refresh_time, sizeof(m_refresh_time[0]), m_nrefresh, fp)
+			== (size_t)m_nrefresh)
+		&& get(fp, m_refresh_loc) && get(fp, m_qloc) && get(fp, m_qdata)
+		&& get(fp, m_qlast) && get(fp, m_clocks_till_idle)
+		&& get(fp, m_mode) && get(fp, m_bl) && get(fp, m_cl)
+		&& get(fp, m_interleave) && get(fp, m_wb_single) && get(fp, m_fail)
+		&& get(fp, m_rd_left) && get(fp, m_rd_bank) && get(fp, m_rd_beat)
+		&& get(fp, m_rd_base) && get(fp, m_rd_col)
+		&& get(fp, m_wr_left) && get(fp, m_wr_bank) && get(fp, m_wr_beat)
+		&& get(fp, m_wr_base) && get(fp, m_wr_col);
+}
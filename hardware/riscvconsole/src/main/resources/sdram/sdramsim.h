@@ -1,55 +1,155 @@
 #ifndef	SDRAMSIM_H
+#define	SDRAMSIM_H
 
-#define	NBANKS	4
+#include <stdint.h>
+
+#include "sdramcfg.h"
+#include "sdramstore.h"
+#include "sdramtrace.h"
+#include "sdramstats.h"
+#include "sdramheat.h"
+
+#define	MAX_NBANKS	8
 #define	POWERED_UP_STATE	6
-#define	CLK_RATE_HZ		100000000 // = 100 MHz = 100 * 10^6
-#define	PWRUP_WAIT_CKS		((int)(.000100 * CLK_RATE_HZ))
-#define	MAX_BANKOPEN_TIME	((int)(.000100 * CLK_RATE_HZ))
-#define	MAX_REFRESH_TIME	((int)(.064 * CLK_RATE_HZ))
 #define	SDRAM_QSZ		16
+#define	SDRAM_SNAPSHOT_MAGIC	"SDRSNP02"
+
+// Packed SDRAM pins, as SDRAMSIM::cycle() and sdramsim.v's sdram_cycle()
+// take them
+#define	SDRAM_CTL_ADDR(C)	((C) & 0x0ffff)
+#define	SDRAM_CTL_BS(C)		(((C) >> 16) & 7)
+#define	SDRAM_CTL_DQM(C)	(((C) >> 19) & 15)
+#define	SDRAM_CTL_DRIV(C)	(((C) >> 23) & 1)
+#define	SDRAM_CTL_WE_N(C)	(((C) >> 24) & 1)
+#define	SDRAM_CTL_CAS_N(C)	(((C) >> 25) & 1)
+#define	SDRAM_CTL_RAS_N(C)	(((C) >> 26) & 1)
+#define	SDRAM_CTL_CS_N(C)	(((C) >> 27) & 1)
+#define	SDRAM_CTL_CKE(C)	(((C) >> 28) & 1)
 
-#define	LGSDRAMSZB	28
-#define	SDRAMSZB	(1<<LGSDRAMSZB)
 
 class	SDRAMSIM {
+	void	set_mode(unsigned mode);
+	void	close_bank(int bs);
+	void	skip(uint64_t n);
+	bool	restore_state(FILE *fp);
+	void	copy_state(const SDRAMSIM &s);
+	unsigned	burst_col(unsigned col, unsigned beat) const;
+
+	SDRAMCFG	m_cfg;
+	int	m_nbanks, m_lanes;
+	unsigned	m_colmsk, m_rowmsk, m_datamsk;
+	// Timing, in clocks
+	int	m_pwrup_wait, m_max_bankopen, m_min_ras;
+	uint64_t	m_max_refresh;
+
 	int	m_pwrup;
-	int	*m_mem;
-	int	m_last_value, m_qmem[4];
-	int	m_bank_status[NBANKS];
-	int	m_bank_row[NBANKS];
-	int	m_bank_open_time[NBANKS];
-	unsigned	*m_refresh_time;
+	// Lane l of word w lives at 16-bit word l*lanewords + w of the store,
+	// so byte offsets of the store match bus offsets into the SDRAM.
+	SDRAMSTORE	*m_mem;
+	int	m_last_value;
+	int	m_bank_status[MAX_NBANKS];
+	int	m_bank_row[MAX_NBANKS];
+	// Clock by which an open bank must have been precharged
+	uint64_t	m_bank_open_deadline[MAX_NBANKS];
+	// For the statistics: whether the open row has served an access yet,
+	// whether opening it closed a different row, the row the last
+	// precharge closed (if any since the last refresh) and the clock the
+	// access the bank is working on started (0 if none)
+	bool	m_bank_used[MAX_NBANKS], m_bank_conflict[MAX_NBANKS];
+	bool	m_bank_closed[MAX_NBANKS];
+	int	m_bank_closed_row[MAX_NBANKS];
+	uint64_t	m_bank_req[MAX_NBANKS];
+	SDRAMSTATS	m_stats;
+	// Refresh bookkeeping is kept as absolute deadlines (in ticks).  Rows
+	// are refreshed in round-robin order, so the entry at m_refresh_loc is
+	// always the oldest one and the only one that needs checking per tick.
+	uint64_t	m_tick;
+	uint64_t	*m_refresh_time;
 	int		m_refresh_loc, m_nrefresh;
-	int	m_qloc, m_qdata[SDRAM_QSZ], m_qmask, m_wr_addr;
+	int	m_qloc, m_qdata[SDRAM_QSZ], m_qmask;
+	// Clock at which the last queued read beat goes out on the bus
+	uint64_t	m_qlast;
 	int	m_clocks_till_idle;
-	bool	m_next_wr;
+	// Mode register: burst length (-1 for full page), CAS latency
+	unsigned	m_mode;
+	int	m_bl, m_cl;
+	bool	m_interleave, m_wb_single;
+	// Bursts in progress.  *_left is the number of beats still to go
+	// (negative for a full page burst, which only ends when interrupted)
+	int	m_rd_left, m_rd_bank, m_rd_beat;
+	unsigned	m_rd_base, m_rd_col;
+	int	m_wr_left, m_wr_bank, m_wr_beat;
+	unsigned	m_wr_base, m_wr_col;
 	unsigned	m_fail;
+	SDRAMTRACE	*m_trace;
+	SDRAMHEAT	*m_heat;
 public:
-	SDRAMSIM(void) {
-		m_mem = new int[SDRAMSZB/2]; // 256 MB (or 512MB), or 128 Mints
+	SDRAMSIM(const SDRAMCFG &cfg = SDRAMCFG(), bool hugepages = false) {
+		m_cfg = cfg;
+		assert((cfg.data_w == 16)||(cfg.data_w == 32));
+		assert(cfg.bank_w <= 3);
+		assert(cfg.col_w <= 10);	// A10 is auto precharge
+		assert(cfg.row_w <= 16);
+		m_nbanks  = 1 << cfg.bank_w;
+		m_lanes   = cfg.lanes();
+		m_colmsk  = (1u << cfg.col_w)-1;
+		m_rowmsk  = (1u << cfg.row_w)-1;
+		m_datamsk = (cfg.data_w >= 32) ? 0xffffffffu : (1u << cfg.data_w)-1;
+		m_pwrup_wait   = (cfg.fast_init) ? 0 : (int)(.000100 * cfg.clk_hz);
+		m_max_bankopen = (int)(.000100 * cfg.clk_hz);
+		// tRAS, 42 ns, in whole clocks
+		m_min_ras = (int)((42 * cfg.clk_hz + 999999999) / 1000000000);
+		m_max_refresh  = (uint64_t)(.064 * cfg.clk_hz);
+		// Each refresh the controller may postpone delays the next
+		// row by one refresh interval
+		m_max_refresh += cfg.refresh_postpone * (m_max_refresh >> cfg.row_w);
+		for(int i=0; i<MAX_NBANKS; i++) {
+			m_bank_status[i] = 0;
+			m_bank_row[i] = 0;
+			m_bank_open_deadline[i] = 0;
+			m_bank_used[i] = m_bank_conflict[i] = false;
+			m_bank_closed[i] = false;
+			m_bank_closed_row[i] = 0;
+			m_bank_req[i] = 0;
+		}
 
-		m_nrefresh = 1<<13;
-		m_refresh_time = new unsigned[m_nrefresh];
+		m_mem = new SDRAMSTORE(cfg.lanewords() * m_lanes, hugepages);
+
+		m_nrefresh = 1<<cfg.row_w;
+		m_refresh_time = new uint64_t[m_nrefresh];
 		for(int i=0; i<m_nrefresh; i++)
 			m_refresh_time[i] = 0;
 		m_refresh_loc = 0;
+		m_tick = 0;
 
 		m_pwrup = 0;
 		m_clocks_till_idle = 0;
 
 		m_last_value = 0;
-		m_clocks_till_idle = PWRUP_WAIT_CKS;
-		m_wr_addr = 0;
+		m_clocks_till_idle = m_pwrup_wait;
+
+		// Until the mode register is set: BL 2, CL 2
+		m_mode = 0x021;
+		m_bl = 2; m_cl = 2;
+		m_interleave = m_wb_single = false;
+		m_rd_left = m_wr_left = 0;
+		m_rd_bank = m_wr_bank = -1;
+		m_rd_beat = m_wr_beat = 0;
+		m_rd_base = m_wr_base = 0;
+		m_rd_col  = m_wr_col  = 0;
 
 		m_qloc  = 0;
+		m_qlast = 0;
 		m_qmask = SDRAM_QSZ-1;
 
-		m_next_wr = true;
 		m_fail = 0;
+		m_trace = NULL;
+		m_heat = NULL;
 	}
 
 	~SDRAMSIM(void) {
 		delete m_mem;
+		delete[] m_refresh_time;
 	}
 
 	int operator()(int clk, int cke,
@@ -58,23 +158,111 @@ public:
 			int driv, int data, int dqm);
 	int	pwrup(void) const { return m_pwrup; }
 
-	void	load(unsigned addr, const char *data, size_t len) {
-		int		*dp;
-		const char	*sp = data;
-		unsigned	base;
-
-		assert((addr&1)==0);
-		base = addr & (SDRAMSZB-1);
-		assert((len&1)==0);
-		assert(addr + len < SDRAMSZB);
-		dp = &m_mem[(base>>1)];
-		for(unsigned k=0; k<len/2; k++) {
-			int	v;
-			v = (sp[0]<<8)|(sp[1]&0x0ff);
-			sp+=2;
-			*dp++ = v;
+	// Clock "cycle" (counting from 1) with the command packed in ctl as
+	// SDRAM_CTL_* below.  Clocks skipped since the last call are taken as
+	// NOP clocks, which is only allowed while idle() holds.
+	int	cycle(uint64_t cycle, unsigned ctl, int data);
+
+	// True when nothing is in flight: no burst going on and no read data
+	// still to come out.  NOP clocks from here on change nothing but the
+	// clock count, so the caller may skip them as long as it returns 0
+	// for the read data.
+	bool	idle(void) const {
+		return (m_pwrup == POWERED_UP_STATE)&&(!m_rd_left)&&(!m_wr_left)
+			&&(!m_fail)&&(m_tick >= m_qlast);
+	}
+
+	const SDRAMSTORE	*mem(void) const { return m_mem; }
+	const SDRAMCFG	&cfg(void) const { return m_cfg; }
+	const SDRAMSTATS	&stats(void) const { return m_stats; }
+	uint64_t	size(void) const { return m_cfg.size(); }
+
+	// Full data bus word (all lanes) at word address w
+	uint32_t	read_word(uint64_t w) const {
+		uint32_t	v = 0;
+		for(int l=0; l<m_lanes; l++)
+			v |= (uint32_t)m_mem->read(l*m_cfg.lanewords() + w) << (16*l);
+		return v;
+	}
+
+	// Write a data bus word, bytes with their DQM bit set are kept
+	void	write_word(uint64_t w, uint32_t data, unsigned dqm) {
+		for(int l=0; l<m_lanes; l++, data >>= 16, dqm >>= 2) {
+			uint64_t	a = l*m_cfg.lanewords() + w;
+			uint16_t	v;
+
+			if ((dqm&3)==3)
+				continue;
+			else if ((dqm&3)==0)
+				v = data;
+			else if ((dqm&2)==0)
+				v = (m_mem->read(a) & 0x000ff) | (data & 0x0ff00);
+			else // if ((dqm&1)==0)
+				v = (m_mem->read(a) & 0x0ff00) | (data & 0x000ff);
+			m_mem->write(a, v);
 		}
 	}
+
+	// Snapshot of the whole model: geometry, memory contents, bank and
+	// burst state, refresh deadlines, the read queue and the counters.
+	// restore() only takes a snapshot of the same geometry, and leaves
+	// the model as it was if the file is not one.  With state false only
+	// the memory contents are restored, for an SDRAM (and controller)
+	// that start from power up again.
+	void	save(FILE *fp) const;
+	bool	restore(FILE *fp, bool state = true);
+	// Geometry of a snapshot, without reading any further
+	static bool	snapshot_cfg(FILE *fp, SDRAMCFG *cfg);
+
+	// Trace commands and data beats (NULL, the default, traces nothing)
+	void	trace(SDRAMTRACE *t) {
+		m_trace = (t)&&(t->level() > SDRAMTRACE_OFF) ? t : NULL;
+	}
+
+	// Count beats and activates into a heatmap (NULL, the default, counts
+	// nothing)
+	void	heat(SDRAMHEAT *h) { m_heat = h; }
+
+	// Calls f(store offset, position in the range, length) for each run
+	// of the bus byte range [off, off+len) that is contiguous in the
+	// store: all of it with the model's own address mapping, at most a
+	// row's worth otherwise.
+	template <class F> void	runs(uint64_t off, size_t len, F f) const {
+		uint64_t	rowbytes = 2ull << m_cfg.col_w;
+
+		assert(off + len <= size());
+		if (m_cfg.addr_map == SDRAM_MAP_RBC) {
+			f(off, (size_t)0, len);
+			return;
+		}
+		for(size_t pos = 0; pos < len; ) {
+			size_t	n = rowbytes - ((off + pos) & (rowbytes-1));
+
+			if (n > len - pos)
+				n = len - pos;
+			f(m_cfg.store_offset(off + pos), pos, n);
+			pos += n;
+		}
+	}
+
+	// Preload a byte image at byte offset "off" of the memory.  Byte n of
+	// the image lands where a bus write to SDRAM base + off + n would.
+	void	load(uint64_t off, const void *data, size_t len) {
+		runs(off, len, [&](uint64_t s, size_t pos, size_t n) {
+			m_mem->load(s, (const char *)data + pos, n); });
+	}
+
+	// Copy a byte range out, the other way round from load()
+	void	dump(uint64_t off, void *data, size_t len) const {
+		runs(off, len, [&](uint64_t s, size_t pos, size_t n) {
+			m_mem->dump(s, (char *)data + pos, n); });
+	}
+
+	// Zero a byte range (ELF .bss)
+	void	clear(uint64_t off, size_t len) {
+		runs(off, len, [&](uint64_t s, size_t, size_t n) {
+			m_mem->clear(s, n); });
+	}
 };
 
 #endif
@@ -1,23 +1,60 @@
 //VCS coverage exclude_file
-import "DPI-C" function int sdram_tick
+import "DPI-C" function int sdram_init
 (
- input int clk,
- input int cke,
- input int cs_n,
- input int ras_n,
- input int cas_n,
- input int we_n,
- input int bs,
- input int addr,
- input int driv,
+ input longint base,
+ input int data_w,
+ input int row_w,
+ input int bank_w,
+ input int col_w,
+ input longint clk_hz,
+ input int fast_init,
+ input int addr_map,
+ input int refresh_postpone
+);
+
+// One SDRAM clock.  ctl packs the pins as SDRAM_CTL_* in sdramsim.h.
+// Returns non-zero when the model is idle: NOP clocks need no call then.
+import "DPI-C" function int sdram_cycle
+(
+ input int handle,
+ input longint cycle,
+ input int ctl,
  input int data,
- input int dqm,
  output int datao
 );
 
+// Performance counter of an instance, indices as in sdramstats.h
+import "DPI-C" function longint sdram_stat
+(
+ input int handle,
+ input int idx
+);
+
+// Backdoor word access to whichever SDRAM holds addr (a bus address),
+// taking no simulated time.  Return 0, or -1 if no SDRAM holds it.
+import "DPI-C" function int sdram_backdoor_read32
+(
+ input longint addr,
+ output int data
+);
+
+import "DPI-C" function int sdram_backdoor_write32
+(
+ input longint addr,
+ input int data
+);
+
 module sdramsim #(
   parameter    SDRAM_DATA_W          = 16,
-  parameter    SDRAM_DQM_W           = 2
+  parameter    SDRAM_DQM_W           = 2,
+  parameter    SDRAM_ROW_W           = 13,
+  parameter    SDRAM_BANK_W          = 2,
+  parameter    SDRAM_COL_W           = 9,
+  parameter    SDRAM_HZ              = 64'd50000000,
+  parameter    SDRAM_FAST_INIT       = 0,
+  parameter    SDRAM_ADDR_MAP        = 0,
+  parameter    SDRAM_REFRESH_POSTPONE = 8,
+  parameter    SDRAM_BASE            = 64'h0
 ) (
   input          sdram_clk_o,
   input          sdram_cke_o,
@@ -26,43 +63,49 @@ module sdramsim #(
   input          sdram_cas_o,
   input          sdram_we_o,
   input  [SDRAM_DQM_W-1:0]   sdram_dqm_o,
-  input  [12:0]  sdram_addr_o,
-  input  [1:0]   sdram_ba_o,
+  input  [SDRAM_ROW_W-1:0]   sdram_addr_o,
+  input  [SDRAM_BANK_W-1:0]  sdram_ba_o,
   output [SDRAM_DATA_W-1:0]  sdram_data_i,
   input  [SDRAM_DATA_W-1:0]  sdram_data_o,
   input          sdram_drive_o,
   input          reset
 );
 
-  int __clk;
-  int __cke; 
-  int __cs_n; 
-  int __ras_n; 
-  int __cas_n; 
-  int __we_n;
-  int __bs;
-  int __addr; 
-  int __driv; 
-  int __data; 
-  int __dqm;
+  int __ctl;
+  int __data;
   int __datao;
-  int __ret;
-  
-  assign __clk = {31'd0, sdram_clk_o};
-  assign __cke = {31'd0, sdram_cke_o};
-  assign __cs_n = {31'd0, sdram_cs_o};
-  assign __ras_n = {31'd0, sdram_ras_o};
-  assign __cas_n = {31'd0, sdram_cas_o};
-  assign __we_n = {31'd0, sdram_we_o};
-  assign __bs = {30'd0, sdram_ba_o};
-  assign __addr = {19'd0, sdram_addr_o};
-  assign __driv = {31'd0, sdram_drive_o};
+  int __idle;
+  longint __cycle;
+  int __sdram;
+  wire __nop;
+
+  wire [3:0]  __dqm = sdram_dqm_o;
+  wire [2:0]  __bs = sdram_ba_o;
+  wire [15:0] __addr = sdram_addr_o;
+
+  assign __ctl = {3'd0, sdram_cke_o, sdram_cs_o, sdram_ras_o, sdram_cas_o, sdram_we_o,
+                  sdram_drive_o, __dqm, __bs, __addr};
   assign __data = sdram_data_o;
-  assign __dqm = sdram_dqm_o;
+  assign __nop = sdram_cs_o | (sdram_ras_o & sdram_cas_o & sdram_we_o);
   assign sdram_data_i = __datao;
-  
+
+  initial begin
+    __sdram = sdram_init(SDRAM_BASE, SDRAM_DATA_W, SDRAM_ROW_W, SDRAM_BANK_W, SDRAM_COL_W, SDRAM_HZ, SDRAM_FAST_INIT, SDRAM_ADDR_MAP,
+                         SDRAM_REFRESH_POSTPONE);
+    __cycle = 0;
+    __idle = 0;
+    __datao = 0;
+  end
+
+  // While the model is idle, NOP clocks only count: skip the call, the
+  // model catches up from the cycle number on the next command
   always @(posedge sdram_clk_o)
-    if(!reset)
-      __ret = sdram_tick(__clk, __cke, __cs_n, __ras_n, __cas_n, __we_n, __bs, __addr, __driv, __data, __dqm, __datao);
+    if(!reset) begin
+      __cycle = __cycle + 1;
+      if((__idle == 0) || !__nop || sdram_drive_o)
+        __idle = sdram_cycle(__sdram, __cycle, __ctl, __data, __datao);
+      else
+        __datao = 0;
+    end
 
 endmodule
@@ -0,0 +1,729 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <vpi_user.h>
+
+#include "sdramsim.h"
+#include "sdramsim_dpi.h"
+#include "sdramcapture.h"
+
+// Returns the values of every "+<name>=<value>" (or "" for a bare
+// "+<name>") in the simulator command line
+static std::vector<const char *> plusargs(const char *name)
+{
+	std::vector<const char *>	vals;
+	s_vpi_vlog_info	info;
+	size_t		len = strlen(name);
+
+	if (!vpi_get_vlog_info(&info))
+		return vals;
+	for(int i=1; i<info.argc; i++) {
+		const char	*arg = info.argv[i];
+		if ((arg[0] != '+')||(strncmp(arg+1, name, len) != 0))
+			continue;
+		if (arg[len+1] == '=')
+			vals.push_back(arg+len+2);
+		else if (arg[len+1] == '\0')
+			vals.push_back(arg+len+1);
+	}
+	return vals;
+}
+
+// First value of a plusarg, NULL if not present
+static const char *plusarg(const char *name)
+{
+	std::vector<const char *>	vals = plusargs(name);
+
+	return (vals.empty()) ? NULL : vals[0];
+}
+
+// One per sdramsim instance.  Everything a tick touches hangs off its
+// own instance, so instances can be evaluated from different threads.
+struct	SDRAM_INST {
+	SDRAMSIM	*sim;
+	SDRAMTRACE	*trace;
+	uint64_t	base;
+	unsigned	index;		// in order of sdram_init() calls
+	// +sdram_save: snapshot file and SDRAM clock to take it at (0: none)
+	std::string	save_file;
+	uint64_t	save_at;
+	SDRAMCAPTURE	*capture;	// +sdram_capture
+	SDRAMHEAT	*heat;		// +sdram_heatmap
+	std::string	heat_file;
+};
+
+//-----------------------------------------------------------------
+// Image preload
+//-----------------------------------------------------------------
+
+// Map a whole file read-only.  Returns NULL (and complains) on failure
+static const char *map_file(const char *fname, size_t *len)
+{
+	struct stat	st;
+	int		fd;
+	void		*p;
+
+	if ((fd = open(fname, O_RDONLY)) < 0) {
+		fprintf(stderr, "SDRAM: cannot open %s\n", fname);
+		return NULL;
+	}
+	if ((fstat(fd, &st) != 0)||(st.st_size == 0)) {
+		fprintf(stderr, "SDRAM: cannot stat %s (or empty)\n", fname);
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "SDRAM: cannot map %s\n", fname);
+		return NULL;
+	}
+	*len = st.st_size;
+	return (const char *)p;
+}
+
+// Translate a bus address into an offset of this SDRAM.  Returns false if
+// the range does not fall in this SDRAM.
+static bool sdram_offset(const SDRAM_INST *inst, uint64_t addr, uint64_t len,
+		uint64_t *off)
+{
+	if ((addr < inst->base)||(addr - inst->base + len > inst->sim->size()))
+		return false;
+	*off = addr - inst->base;
+	return true;
+}
+
+// True if the bus address addr belongs to this SDRAM, whether or not a
+// range starting there fits in it
+static bool sdram_owns(const SDRAM_INST *inst, uint64_t addr)
+{
+	return (addr >= inst->base)&&(addr - inst->base < inst->sim->size());
+}
+
+// +sdram_load=<file>[@<addr>]: raw binary image.  Without an address the
+// image goes to the start of the first SDRAM.  An address below the base
+// of the first SDRAM is an offset into it (this form only: ELF segments
+// and the backdoor go by bus address).
+static void load_bin(SDRAM_INST *inst, const char *arg)
+{
+	std::string	fname(arg);
+	uint64_t	addr = inst->base, off;
+	size_t		at = fname.rfind('@'), len;
+	const char	*img;
+
+	if (at != std::string::npos) {
+		addr = strtoull(fname.c_str()+at+1, NULL, 0);
+		fname.resize(at);
+		if ((inst->index == 0)&&(addr < inst->base))
+			addr += inst->base;
+	} else if (inst->index != 0)
+		return;
+	if (!sdram_owns(inst, addr))
+		return;
+	if (!(img = map_file(fname.c_str(), &len)))
+		exit(-1);
+	if (!sdram_offset(inst, addr, len, &off)) {
+		fprintf(stderr, "SDRAM: %s (%zu bytes @ 0x%08lx) does not fit in the SDRAM\n",
+			fname.c_str(), len, (unsigned long)addr);
+		exit(-1);
+	}
+	inst->sim->load(off, img, len);
+	munmap((void *)img, len);
+	printf("SDRAM: loaded %s, %zu bytes @ 0x%08lx\n",
+		fname.c_str(), len, (unsigned long)(inst->base + off));
+}
+
+template <class Ehdr, class Phdr>
+static void load_elf_segments(SDRAM_INST *inst, const char *fname,
+		const char *img, size_t len)
+{
+	const Ehdr	*eh = (const Ehdr *)img;
+
+	for(unsigned i=0; i<eh->e_phnum; i++) {
+		const Phdr	*ph = (const Phdr *)(img + eh->e_phoff + i*eh->e_phentsize);
+		uint64_t	off;
+
+		if ((ph->p_type != PT_LOAD)||(ph->p_memsz == 0))
+			continue;
+		if (!sdram_owns(inst, ph->p_paddr))
+			continue;	// Some other memory's
+		if (!sdram_offset(inst, ph->p_paddr, ph->p_memsz, &off)) {
+			printf("SDRAM: %s: skipping segment @ 0x%08lx (does not fit)\n",
+				fname, (unsigned long)ph->p_paddr);
+			continue;
+		}
+		assert(ph->p_offset + ph->p_filesz <= len);
+		inst->sim->load(off, img + ph->p_offset, ph->p_filesz);
+		inst->sim->clear(off + ph->p_filesz, ph->p_memsz - ph->p_filesz);
+		printf("SDRAM: loaded %s segment, %lu bytes @ 0x%08lx\n", fname,
+			(unsigned long)ph->p_memsz, (unsigned long)ph->p_paddr);
+	}
+}
+
+// +sdram_load_elf=<file>: every PT_LOAD segment that falls in the SDRAM
+static void load_elf(SDRAM_INST *inst, const char *fname)
+{
+	const char	*img;
+	size_t		len;
+
+	if (!(img = map_file(fname, &len)))
+		exit(-1);
+	if ((len < EI_NIDENT)||(memcmp(img, ELFMAG, SELFMAG) != 0)) {
+		fprintf(stderr, "SDRAM: %s is not an ELF file\n", fname);
+		exit(-1);
+	}
+	if (img[EI_CLASS] == ELFCLASS32)
+		load_elf_segments<Elf32_Ehdr, Elf32_Phdr>(inst, fname, img, len);
+	else
+		load_elf_segments<Elf64_Ehdr, Elf64_Phdr>(inst, fname, img, len);
+	munmap((void *)img, len);
+}
+
+//-----------------------------------------------------------------
+// DPI
+//-----------------------------------------------------------------
+
+// All instances, in order of creation.  The handle of an instance is its
+// index plus one rather than a pointer, passed as a DPI int: a handle is
+// kept in sdramsim.v, so it must still mean the same after a Verilator
+// restore into another process.  Only instance creation and the exit handler take the lock,
+// nothing is ever removed, and sdram_cycle() works on its own instance
+// alone.
+#define	SDRAM_MAX_INSTANCES	16
+static std::mutex	instances_lock;
+static SDRAM_INST	*instances[SDRAM_MAX_INSTANCES];
+static unsigned		ninstances;
+
+static inline SDRAM_INST *inst_of(int handle)
+{
+	return instances[handle - 1];
+}
+
+static inline int handle_of(const SDRAM_INST *inst)
+{
+	return inst->index + 1;
+}
+
+// +sdram_trace=off|summary|full (or 0/1/2)
+static int trace_level(const char *arg)
+{
+	if (!arg)
+		return SDRAMTRACE_OFF;
+	if ((arg[0] == '\0')||(strcmp(arg, "full") == 0)||(strcmp(arg, "2") == 0))
+		return SDRAMTRACE_FULL;
+	if ((strcmp(arg, "summary") == 0)||(strcmp(arg, "1") == 0))
+		return SDRAMTRACE_SUMMARY;
+	if ((strcmp(arg, "off") != 0)&&(strcmp(arg, "0") != 0))
+		fprintf(stderr, "SDRAM: unknown trace level \"%s\", tracing off\n", arg);
+	return SDRAMTRACE_OFF;
+}
+
+// Name of an instance in reports: "SDRAM", with its base address when
+// there is more than one
+static std::string inst_name(const SDRAM_INST *inst)
+{
+	char	buf[32];
+
+	if (ninstances < 2)
+		return "SDRAM";
+	snprintf(buf, sizeof(buf), "SDRAM@0x%08lx", (unsigned long)inst->base);
+	return buf;
+}
+
+static void dump_mem(const char *arg);
+
+static void sdram_exit(void)
+{
+	std::lock_guard<std::mutex>	lk(instances_lock);
+
+	for(unsigned i=0; i<ninstances; i++) {
+		SDRAM_INST	*inst = instances[i];
+
+		inst->trace->close();
+		inst->trace->summary(stdout, inst_name(inst).c_str());
+		if (inst->capture) {
+			// To check sdramreplay against
+			inst->capture->close();
+			printf("%s: memory hash %016lx\n", inst_name(inst).c_str(),
+				(unsigned long)inst->sim->mem()->hash());
+		}
+		inst->sim->stats().print(stdout, inst_name(inst).c_str(),
+			1 << inst->sim->cfg().bank_w);
+		if (inst->heat) {
+			inst->heat->summary(stdout, inst_name(inst).c_str());
+			if (!inst->heat->save(inst->heat_file.c_str(), inst->base))
+				fprintf(stderr, "SDRAM: cannot write heatmap %s\n",
+					inst->heat_file.c_str());
+		}
+	}
+	for(const char *arg : plusargs("sdram_dump"))
+		dump_mem(arg);
+}
+
+// File name for instance n: the name itself for the first one,
+// <name>.<n> for the others
+static std::string inst_file(const char *name, unsigned n)
+{
+	char	buf[16];
+
+	if (n == 0)
+		return name;
+	snprintf(buf, sizeof(buf), ".%u", n);
+	return std::string(name) + buf;
+}
+
+// Create and register a model, its trace included
+static SDRAM_INST *sdram_new(uint64_t base, const SDRAMCFG &cfg)
+{
+	const char	*huge = plusarg("sdram_hugepages");
+	const char	*tfile = plusarg("sdram_trace_file");
+	SDRAM_INST	*inst = new SDRAM_INST;
+	std::string	tname((tfile) ? tfile : "sdram.trace");
+
+	inst->sim  = new SDRAMSIM(cfg, (huge)&&(strcmp(huge, "0") != 0));
+	inst->base = base;
+	inst->save_at = 0;
+	inst->capture = NULL;
+	inst->heat = NULL;
+
+	std::lock_guard<std::mutex>	lk(instances_lock);
+
+	if (ninstances >= SDRAM_MAX_INSTANCES) {
+		fprintf(stderr, "SDRAM: more than %d SDRAMs\n", SDRAM_MAX_INSTANCES);
+		exit(-1);
+	}
+	inst->index = ninstances;
+	if (inst->index == 0)
+		atexit(sdram_exit);
+	else {
+		// Every other SDRAM traces to <file>.<base>
+		char	buf[32];
+		snprintf(buf, sizeof(buf), ".%08lx", (unsigned long)base);
+		tname += buf;
+	}
+	instances[ninstances++] = inst;
+
+	printf("SDRAM: %d-bit, %d row, %d bank, %d column bits, %lu MB @ 0x%08lx%s%s\n",
+		cfg.data_w, cfg.row_w, cfg.bank_w, cfg.col_w,
+		(unsigned long)(inst->sim->size() >> 20), (unsigned long)base,
+		(cfg.fast_init) ? ", fast init" : "",
+		(cfg.addr_map == SDRAM_MAP_BRC) ? ", bank-row-column"
+		: (cfg.addr_map == SDRAM_MAP_XOR) ? ", XOR banks" : "");
+
+	inst->trace = new SDRAMTRACE(trace_level(plusarg("sdram_trace")),
+		tname.c_str());
+	inst->sim->trace(inst->trace);
+	return inst;
+}
+
+//-----------------------------------------------------------------
+// Snapshots
+//
+// A snapshot holds one file per SDRAM: the base address followed by
+// SDRAMSIM::save().  The SDRAM state is not part of a Verilator --savable
+// model, so a harness that saves or restores the model should call
+// sdram_save_all() / sdram_restore_all() (sdramsim_dpi.h) next to it.
+//-----------------------------------------------------------------
+
+static bool inst_save(const SDRAM_INST *inst, const char *fname)
+{
+	FILE	*fp = fopen(fname, "wb");
+
+	if (!fp) {
+		fprintf(stderr, "SDRAM: cannot create snapshot %s\n", fname);
+		return false;
+	}
+	fwrite(&inst->base, sizeof(inst->base), 1, fp);
+	inst->sim->save(fp);
+	fclose(fp);
+	printf("SDRAM: saved %s @ 0x%08lx\n", fname, (unsigned long)inst->base);
+	return true;
+}
+
+// Restore instance n from its file, creating it (from the geometry in the
+// file) if it does not exist yet.  With state false, only the memory.
+static bool inst_restore(unsigned n, const char *fname, bool state)
+{
+	FILE		*fp = fopen(fname, "rb");
+	uint64_t	base;
+	SDRAMCFG	cfg;
+	bool		ok;
+
+	if (!fp) {
+		fprintf(stderr, "SDRAM: cannot open snapshot %s\n", fname);
+		return false;
+	}
+	ok = (fread(&base, sizeof(base), 1, fp) == 1)
+		&&(SDRAMSIM::snapshot_cfg(fp, &cfg));
+	if ((ok)&&(n >= ninstances))
+		sdram_new(base, cfg);
+	if ((ok)&&(base != instances[n]->base)) {
+		fprintf(stderr, "SDRAM: snapshot %s is of the SDRAM @ 0x%08lx\n",
+			fname, (unsigned long)base);
+		ok = false;
+	}
+	ok = ok && instances[n]->sim->restore(fp, state);
+	fclose(fp);
+	if (ok)
+		printf("SDRAM: restored %s%s @ 0x%08lx\n", fname,
+			(state) ? "" : " memory", (unsigned long)base);
+	else
+		fprintf(stderr, "SDRAM: cannot restore %s\n", fname);
+	return ok;
+}
+
+extern "C" int sdram_save_all(const char *fname)
+{
+	for(unsigned i=0; i<ninstances; i++)
+		if (!inst_save(instances[i], inst_file(fname, i).c_str()))
+			return -1;
+	return 0;
+}
+
+extern "C" int sdram_restore_all(const char *fname)
+{
+	for(unsigned i=0; ; i++) {
+		std::string	name = inst_file(fname, i);
+
+		if ((i >= ninstances)&&(access(name.c_str(), R_OK) != 0))
+			return (i > 0) ? 0 : -1;
+		if (!inst_restore(i, name.c_str(), true))
+			return -1;
+	}
+}
+
+//-----------------------------------------------------------------
+// DPI
+//-----------------------------------------------------------------
+
+// Called once from the initial block of every sdramsim.v instance, before
+// reset is released.  base is the bus address the SDRAM is mapped at, the
+// rest comes from sdram_bb_cfg.  Returns the handle the instance passes
+// to sdram_cycle().
+//
+// +sdram_save=<file>@<clock> snapshots the SDRAM at that SDRAM clock.
+// +sdram_restore=<file> takes the memory contents of a snapshot, before
+// any +sdram_load.  The rest of the SDRAM state is only any good with the
+// RTL state that goes with it, which a fresh simulation does not have:
+// that is what sdram_restore_all() is for.
+//
+// +sdram_capture=<file> records the command stream for sdramreplay
+// (sdramcapture.h), from the end of sdram_init() on.
+//
+// +sdram_heatmap=<file> counts the traffic per page and row, written out
+// at exit (sdramheat.h).
+extern "C" int sdram_init(long long base, int data_w, int row_w, int bank_w,
+		int col_w, long long clk_hz, int fast_init, int addr_map,
+		int refresh_postpone)
+{
+	const char	*fast = plusarg("sdram_fast_init");
+	const char	*restore = plusarg("sdram_restore");
+	const char	*save = plusarg("sdram_save");
+	const char	*capture = plusarg("sdram_capture");
+	const char	*heatmap = plusarg("sdram_heatmap");
+	SDRAM_INST	*inst;
+	SDRAMCFG	cfg;
+
+	cfg.data_w = data_w;
+	cfg.row_w  = row_w;
+	cfg.bank_w = bank_w;
+	cfg.col_w  = col_w;
+	cfg.clk_hz = clk_hz;
+	cfg.addr_map = addr_map;
+	cfg.refresh_postpone = refresh_postpone;
+	// +sdram_fast_init[=0|1] overrides SDRAM_FAST_INIT.  A model with the
+	// full wait fails on a fast init controller, the other way round it
+	// just accepts the init commands whenever they come.
+	cfg.fast_init = (fast) ? (strcmp(fast, "0") != 0) : (fast_init != 0);
+	inst = sdram_new(base, cfg);
+
+	if ((restore)&&(!inst_restore(inst->index,
+			inst_file(restore, inst->index).c_str(), false)))
+		exit(-1);
+	if (save) {
+		std::string	arg(save);
+		size_t		at = arg.rfind('@');
+
+		if (at == std::string::npos) {
+			fprintf(stderr, "SDRAM: +sdram_save=<file>@<clock>\n");
+			exit(-1);
+		}
+		inst->save_at = strtoull(arg.c_str()+at+1, NULL, 0);
+		arg.resize(at);
+		inst->save_file = inst_file(arg.c_str(), inst->index);
+	}
+
+	for(const char *arg : plusargs("sdram_load"))
+		load_bin(inst, arg);
+	for(const char *arg : plusargs("sdram_load_elf"))
+		load_elf(inst, arg);
+
+	if (capture) {
+		inst->capture = new SDRAMCAPTURE(
+			inst_file(capture, inst->index).c_str(), base, *inst->sim);
+		if (!inst->capture->ok())
+			exit(-1);
+	}
+	if (heatmap) {
+		inst->heat = new SDRAMHEAT(cfg);
+		inst->heat_file = inst_file(heatmap, inst->index);
+		inst->sim->heat(inst->heat);
+	}
+
+	return handle_of(inst);
+}
+
+// One SDRAM clock, the pins packed into ctl as SDRAM_CTL_* (sdramsim.h).
+// cycle counts SDRAM clocks from 1; clocks sdramsim.v did not call us for
+// are taken as NOPs.  Returns non-zero when the model is idle, meaning the
+// caller may skip the calls for NOP clocks (with read data 0) until the
+// next command.
+extern "C" int sdram_cycle(int handle, long long cycle, int ctl, int data,
+		int *datao)
+{
+	SDRAM_INST	*inst = inst_of(handle);
+
+	if (inst->capture)
+		inst->capture->record(cycle, ctl, data);
+	*datao = inst->sim->cycle(cycle, (unsigned)ctl, data);
+	// Idle clocks may be skipped, so this is the first clock at or after
+	if ((inst->save_at)&&((uint64_t)cycle >= inst->save_at)) {
+		inst->save_at = 0;
+		inst_save(inst, inst->save_file.c_str());
+	}
+	return inst->sim->idle();
+}
+
+// Performance counter idx (SDRAMSTAT_*, see sdramstats.h) of an instance
+extern "C" long long sdram_stat(int handle, int idx)
+{
+	return (long long)inst_of(handle)->sim->stats().get(idx);
+}
+
+//-----------------------------------------------------------------
+// Backdoor
+//
+// Memory accesses that go straight to the model's store, taking no
+// simulated time.  Addresses are bus addresses, routed to the SDRAM that
+// holds them.  The caches in front of the SDRAM are not kept coherent:
+// backdoor writes are for memory the harts have not cached yet (or will
+// not look at before a fence.i / flush).  The model must not be running
+// in another thread while these are called.
+//-----------------------------------------------------------------
+
+// The SDRAM holding the whole range, NULL if none
+static SDRAM_INST *inst_at(uint64_t addr, uint64_t len)
+{
+	for(unsigned i=0; i<ninstances; i++) {
+		SDRAM_INST	*inst = instances[i];
+
+		if ((addr >= inst->base)&&(addr - inst->base + len <= inst->sim->size()))
+			return inst;
+	}
+	return NULL;
+}
+
+extern "C" int sdram_backdoor_covers(unsigned long long addr, size_t len)
+{
+	return inst_at(addr, len) != NULL;
+}
+
+extern "C" int sdram_backdoor_write(unsigned long long addr, const void *data,
+		size_t len)
+{
+	SDRAM_INST	*inst = inst_at(addr, len);
+
+	if (!inst)
+		return -1;
+	inst->sim->load(addr - inst->base, data, len);
+	return 0;
+}
+
+extern "C" int sdram_backdoor_read(unsigned long long addr, void *data,
+		size_t len)
+{
+	SDRAM_INST	*inst = inst_at(addr, len);
+
+	if (!inst)
+		return -1;
+	inst->sim->dump(addr - inst->base, data, len);
+	return 0;
+}
+
+// Word versions for SystemVerilog (sdramsim.v imports them)
+extern "C" int sdram_backdoor_read32(long long addr, int *data)
+{
+	uint32_t	v = 0;
+	int		r = sdram_backdoor_read(addr, &v, sizeof(v));
+
+	*data = (int)v;
+	return r;
+}
+
+extern "C" int sdram_backdoor_write32(long long addr, int data)
+{
+	uint32_t	v = data;
+
+	return sdram_backdoor_write(addr, &v, sizeof(v));
+}
+
+// +sdram_dump=<file>[@<addr>[:<len>]]: write memory out at exit, from addr
+// to the end of its SDRAM without a length, the whole first SDRAM without
+// an address
+static void dump_mem(const char *arg)
+{
+	std::string	fname(arg);
+	size_t		at = fname.rfind('@');
+	uint64_t	addr = instances[0]->base, len = instances[0]->sim->size();
+	char		*buf;
+	FILE		*fp;
+
+	if (at != std::string::npos) {
+		char	*end;
+
+		addr = strtoull(fname.c_str()+at+1, &end, 0);
+		len  = 0;
+		if (*end == ':')
+			len = strtoull(end+1, NULL, 0);
+		else if (SDRAM_INST *inst = inst_at(addr, 1))	// To its end
+			len = inst->base + inst->sim->size() - addr;
+		fname.resize(at);
+	}
+	buf = new char[len];
+	if (sdram_backdoor_read(addr, buf, len) != 0)
+		fprintf(stderr, "SDRAM: cannot dump 0x%08lx+%lu, not in an SDRAM\n",
+			(unsigned long)addr, (unsigned long)len);
+	else if (!(fp = fopen(fname.c_str(), "wb")))
+		fprintf(stderr, "SDRAM: cannot create %s\n", fname.c_str());
+	else {
+		fwrite(buf, len, 1, fp);
+		fclose(fp);
+		printf("SDRAM: dumped 0x%08lx+%lu to %s\n", (unsigned long)addr,
+			(unsigned long)len, fname.c_str());
+	}
+	delete[] buf;
+}
+
+//-----------------------------------------------------------------
+// Functional mode (sdramfunc.v)
+//
+// The SDRAM TileLink port can be served straight from the model's memory,
+// without the controller, while the timing is of no interest (booting).
+// The port starts functional with +sdram_functional[=<clock>], and goes
+// over to the controller and the pin-level model:
+//   - at that controller clock, if one is given,
+//   - on the first write to +sdram_functional_trigger=<addr>, or
+//   - when the harness calls sdram_functional(0).
+// The controller refreshes all along, so the model is in a valid state at
+// the switch.  The port only switches with nothing in flight.
+//-----------------------------------------------------------------
+
+struct	SDRAM_FUNC {
+	uint64_t	base;
+	int		mode, want;
+	uint64_t	switch_at, trigger;
+	uint64_t	reads, writes, switched;
+};
+
+#define	SDRAM_MAX_FUNCS		SDRAM_MAX_INSTANCES
+static SDRAM_FUNC	funcs[SDRAM_MAX_FUNCS];
+static unsigned		nfuncs;
+
+static void func_exit(void)
+{
+	for(unsigned i=0; i<nfuncs; i++) {
+		const SDRAM_FUNC	&f = funcs[i];
+
+		if ((f.reads == 0)&&(f.writes == 0))
+			continue;
+		printf("SDRAM@0x%08lx: %lu functional reads, %lu writes",
+			(unsigned long)f.base, (unsigned long)f.reads,
+			(unsigned long)f.writes);
+		if (f.switched)
+			printf(", pin level from clock %lu", (unsigned long)f.switched);
+		printf("\n");
+	}
+}
+
+extern "C" int sdram_func_init(long long base)
+{
+	const char	*func = plusarg("sdram_functional");
+	const char	*trig = plusarg("sdram_functional_trigger");
+	std::lock_guard<std::mutex>	lk(instances_lock);
+	SDRAM_FUNC	*f;
+
+	if (nfuncs >= SDRAM_MAX_FUNCS) {
+		fprintf(stderr, "SDRAM: more than %d functional ports\n", SDRAM_MAX_FUNCS);
+		exit(-1);
+	}
+	if (nfuncs == 0)
+		atexit(func_exit);
+	f = &funcs[nfuncs++];
+	f->base = base;
+	f->mode = f->want = (func != NULL);
+	f->switch_at = (func) ? strtoull(func, NULL, 0) : 0;
+	f->trigger = (trig) ? strtoull(trig, NULL, 0) : ~0ull;
+	f->reads = f->writes = f->switched = 0;
+	if (f->mode)
+		printf("SDRAM@0x%08lx: functional until %s\n", (unsigned long)base,
+			(f->switch_at) ? func : "triggered");
+	return nfuncs;
+}
+
+extern "C" int sdram_func_mode(int handle, long long cycle, int idle)
+{
+	SDRAM_FUNC	*f = &funcs[handle - 1];
+
+	if ((f->mode)&&(f->switch_at)&&((uint64_t)cycle >= f->switch_at))
+		f->want = 0;
+	if ((idle)&&(f->mode != f->want)) {
+		f->mode = f->want;
+		if (!f->mode)
+			f->switched = cycle;
+		printf("SDRAM@0x%08lx: %s at clock %lu\n", (unsigned long)f->base,
+			(f->mode) ? "functional" : "pin level", (unsigned long)cycle);
+	}
+	return f->mode;
+}
+
+extern "C" int sdram_func_access(int handle, long long addr, int we, int mask,
+		int wdata, int *rdata)
+{
+	SDRAM_FUNC	*f = &funcs[handle - 1];
+	uint8_t		buf[4];
+	uint64_t	a = addr & ~3ull;
+
+	*rdata = 0;
+	if (sdram_backdoor_read(a, buf, sizeof(buf)) != 0) {
+		fprintf(stderr, "SDRAM: functional access to 0x%08lx, not in an SDRAM\n",
+			(unsigned long)addr);
+		return -1;
+	}
+	if (we) {
+		for(int i=0; i<4; i++)
+			if (mask & (1<<i))
+				buf[i] = wdata >> (8*i);
+		sdram_backdoor_write(a, buf, sizeof(buf));
+		f->writes++;
+		if ((uint64_t)addr == f->trigger)
+			f->want = 0;
+	} else {
+		memcpy(rdata, buf, sizeof(buf));
+		f->reads++;
+	}
+	return 0;
+}
+
+extern "C" void sdram_functional(int on)
+{
+	for(unsigned i=0; i<nfuncs; i++)
+		funcs[i].want = (on != 0);
+}
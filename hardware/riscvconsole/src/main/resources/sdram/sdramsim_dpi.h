@@ -0,0 +1,45 @@
+#ifndef	SDRAMSIM_DPI_H
+#define	SDRAMSIM_DPI_H
+
+// Calls into the SDRAM models for the C++ side of a simulation (the
+// harness), as opposed to the DPI functions sdramsim.v imports.
+
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+// Snapshot every SDRAM to <fname> (first SDRAM), <fname>.1, ...  Returns
+// 0 on success.  Take it together with the Verilator model's own save.
+int	sdram_save_all(const char *fname);
+
+// Restore every SDRAM from a snapshot taken by sdram_save_all().  SDRAMs
+// that do not exist yet (the initial blocks of a restored Verilator model
+// do not run again) are created from the snapshot.  Returns 0 on success.
+int	sdram_restore_all(const char *fname);
+
+// Backdoor access to the SDRAM contents, by bus address, taking no
+// simulated time.  The range must fall in a single SDRAM; both return 0
+// on success and -1 if no SDRAM holds it.  Nothing keeps the caches
+// coherent with a backdoor write, and the models must not be evaluated
+// while these run.
+//
+// A debug front end (remote bitbang, DMI) that sees a bulk memory access
+// can ask sdram_backdoor_covers() and serve it here instead of through
+// the system bus access or program buffer.
+int	sdram_backdoor_covers(unsigned long long addr, size_t len);
+int	sdram_backdoor_read(unsigned long long addr, void *data, size_t len);
+int	sdram_backdoor_write(unsigned long long addr, const void *data, size_t len);
+
+// Functional mode of the SDRAM TileLink ports (SDRAMConfig.simFunctional):
+// 1 to serve them straight from the model's memory, 0 to go through the
+// controller and pin-level model.  Takes effect once no access is in
+// flight.
+void	sdram_functional(int on);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef	SDRAMSTATS_H
+#define	SDRAMSTATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Performance counters of the SDRAM model, counted once the SDRAM is out
+// of its power up sequence.  The indices are also what sdram_stat() takes
+// from the DPI side, so they must not be renumbered.
+//
+// Each read or write command is classified against the bank it goes to:
+//   row hit       the row was already open and had served an access
+//   row miss      first access after an ACT to a bank that was idle
+//   row conflict  first access after an ACT that replaced a different row
+//                 (the bank was precharged to open this one)
+//
+// The read latency is counted from the first command issued for the
+// access (PRE or ACT of the bank, or the READ itself on a row hit) to the
+// first data beat on the bus, in clocks.
+enum	SDRAMSTAT {
+	SDRAMSTAT_TICKS = 0,	// clocks in operation
+	SDRAMSTAT_IDLE,		// NOP clocks with every bank precharged
+	SDRAMSTAT_NOP,		// NOP or DESELECT clocks
+	SDRAMSTAT_READS,	// read commands
+	SDRAMSTAT_WRITES,	// write commands
+	SDRAMSTAT_RD_BEATS,	// data beats driven by the SDRAM
+	SDRAMSTAT_WR_BEATS,	// data beats driven by the controller
+	SDRAMSTAT_ROW_HIT,
+	SDRAMSTAT_ROW_MISS,
+	SDRAMSTAT_ROW_CONFLICT,
+	SDRAMSTAT_ACTS,		// activates, all banks
+	SDRAMSTAT_REFRESH,	// auto refresh commands
+	SDRAMSTAT_ACT   = 16,	// + bank: activates per bank
+	SDRAMSTAT_RDLAT = 24,	// + clocks: read latency histogram
+	SDRAMSTAT_N     = 56
+};
+
+#define	SDRAMSTAT_NLAT	(SDRAMSTAT_N - SDRAMSTAT_RDLAT)	// last one is "or more"
+
+class	SDRAMSTATS {
+	uint64_t	m_c[SDRAMSTAT_N];
+
+	static double	pct(uint64_t n, uint64_t d) {
+		return (d) ? 100.0 * n / d : 0.0;
+	}
+public:
+	SDRAMSTATS(void) { clear(); }
+
+	void	clear(void) { memset(m_c, 0, sizeof(m_c)); }
+	void	inc(unsigned idx) { m_c[idx]++; }
+	void	add(unsigned idx, uint64_t n) { m_c[idx] += n; }
+	uint64_t	get(unsigned idx) const {
+		return (idx < SDRAMSTAT_N) ? m_c[idx] : 0;
+	}
+
+	void	rdlat(uint64_t clocks) {
+		if (clocks >= SDRAMSTAT_NLAT)
+			clocks = SDRAMSTAT_NLAT-1;
+		m_c[SDRAMSTAT_RDLAT + clocks]++;
+	}
+
+	void	print(FILE *fp, const char *name, int nbanks) const {
+		uint64_t	ticks = m_c[SDRAMSTAT_TICKS];
+		uint64_t	acc = m_c[SDRAMSTAT_READS] + m_c[SDRAMSTAT_WRITES];
+		uint64_t	beats = m_c[SDRAMSTAT_RD_BEATS] + m_c[SDRAMSTAT_WR_BEATS];
+		uint64_t	nlat = 0, slat = 0;
+
+		if (ticks == 0)
+			return;
+		fprintf(fp, "%s statistics (%lu clocks)\n", name, (unsigned long)ticks);
+		fprintf(fp, "  %-16s %12lu %6.2f%%\n", "idle clocks",
+			(unsigned long)m_c[SDRAMSTAT_IDLE], pct(m_c[SDRAMSTAT_IDLE], ticks));
+		fprintf(fp, "  %-16s %12lu %6.2f%%\n", "nop clocks",
+			(unsigned long)m_c[SDRAMSTAT_NOP], pct(m_c[SDRAMSTAT_NOP], ticks));
+		fprintf(fp, "  %-16s %12lu %6.2f%%\n", "data bus busy",
+			(unsigned long)beats, pct(beats, ticks));
+		fprintf(fp, "  %-16s %12lu (%lu beats)\n", "reads",
+			(unsigned long)m_c[SDRAMSTAT_READS],
+			(unsigned long)m_c[SDRAMSTAT_RD_BEATS]);
+		fprintf(fp, "  %-16s %12lu (%lu beats)\n", "writes",
+			(unsigned long)m_c[SDRAMSTAT_WRITES],
+			(unsigned long)m_c[SDRAMSTAT_WR_BEATS]);
+		fprintf(fp, "  %-16s %12lu %6.2f%%\n", "row hits",
+			(unsigned long)m_c[SDRAMSTAT_ROW_HIT], pct(m_c[SDRAMSTAT_ROW_HIT], acc));
+		fprintf(fp, "  %-16s %12lu %6.2f%%\n", "row misses",
+			(unsigned long)m_c[SDRAMSTAT_ROW_MISS], pct(m_c[SDRAMSTAT_ROW_MISS], acc));
+		fprintf(fp, "  %-16s %12lu %6.2f%%\n", "row conflicts",
+			(unsigned long)m_c[SDRAMSTAT_ROW_CONFLICT],
+			pct(m_c[SDRAMSTAT_ROW_CONFLICT], acc));
+		fprintf(fp, "  %-16s %12lu\n", "refreshes",
+			(unsigned long)m_c[SDRAMSTAT_REFRESH]);
+		fprintf(fp, "  %-16s %12lu  ", "activates",
+			(unsigned long)m_c[SDRAMSTAT_ACTS]);
+		for(int b=0; b<nbanks; b++)
+			fprintf(fp, " %lu", (unsigned long)m_c[SDRAMSTAT_ACT+b]);
+		fprintf(fp, "\n");
+
+		for(int i=0; i<SDRAMSTAT_NLAT; i++) {
+			nlat += m_c[SDRAMSTAT_RDLAT+i];
+			slat += i * m_c[SDRAMSTAT_RDLAT+i];
+		}
+		if (nlat == 0)
+			return;
+		fprintf(fp, "  read latency, mean %.2f clocks\n", (double)slat / nlat);
+		for(int i=0; i<SDRAMSTAT_NLAT; i++) {
+			uint64_t	n = m_c[SDRAMSTAT_RDLAT+i];
+			if (n == 0)
+				continue;
+			fprintf(fp, "    %2d%s %12lu %6.2f%%\n", i,
+				(i == SDRAMSTAT_NLAT-1) ? "+" : " ",
+				(unsigned long)n, pct(n, nlat));
+		}
+	}
+};
+
+#endif
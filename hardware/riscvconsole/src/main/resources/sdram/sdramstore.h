@@ -0,0 +1,266 @@
+#ifndef	SDRAMSTORE_H
+#define	SDRAMSTORE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+#if	defined(__BYTE_ORDER__)&&(__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error	"SDRAMSTORE bulk loads assume a little-endian host"
+#endif
+
+// Backing store for the SDRAM model.
+//
+// The memory is kept as 16-bit words split in pages which are only
+// allocated the first time they are written.  Reads to a page that was
+// never written return zero without allocating anything, so a simulator
+// only pays (in RSS) for the memory the program actually touches.
+//
+// With hugepages enabled, pages are 2MB and are mapped with MAP_HUGETLB
+// when the host has reserved hugepages, or with transparent hugepages
+// otherwise.
+#define	SDRAMSTORE_LGPAGE	11	// 2k words, 4kB
+#define	SDRAMSTORE_LGHUGEPAGE	20	// 1M words, 2MB
+
+class	SDRAMSTORE {
+	uint16_t	**m_pages;
+	size_t		m_nwords, m_npages, m_nalloc;
+	unsigned	m_lgpage;
+	bool		m_huge;
+
+	uint16_t	*alloc_page(void) {
+		size_t	bytes = sizeof(uint16_t) << m_lgpage;
+		void	*p;
+
+		if (!m_huge)
+			return (uint16_t *)calloc(1, bytes);
+
+		p = mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED)
+			return (uint16_t *)p;
+
+		// No reserved hugepages: over-map, align to the page size and
+		// ask for transparent hugepages on the aligned part
+		char	*raw = (char *)mmap(NULL, 2*bytes, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		assert(raw != MAP_FAILED);
+		uintptr_t	base = ((uintptr_t)raw + bytes-1) & ~(uintptr_t)(bytes-1);
+		if (base > (uintptr_t)raw)
+			munmap(raw, base - (uintptr_t)raw);
+		munmap((char *)base + bytes, (uintptr_t)raw + bytes - base);
+#ifdef	MADV_HUGEPAGE
+		madvise((void *)base, bytes, MADV_HUGEPAGE);
+#endif
+		return (uint16_t *)base;
+	}
+
+	void	free_page(uint16_t *p) {
+		if (m_huge)
+			munmap(p, sizeof(uint16_t) << m_lgpage);
+		else
+			free(p);
+	}
+
+public:
+	SDRAMSTORE(size_t nwords, bool huge = false) {
+		m_huge   = huge;
+		m_lgpage = (huge) ? SDRAMSTORE_LGHUGEPAGE : SDRAMSTORE_LGPAGE;
+		m_nwords = nwords;
+		m_npages = (nwords + (1ul<<m_lgpage)-1) >> m_lgpage;
+		m_nalloc = 0;
+		m_pages  = new uint16_t *[m_npages];
+		for(size_t i=0; i<m_npages; i++)
+			m_pages[i] = NULL;
+	}
+
+	~SDRAMSTORE(void) {
+		for(size_t i=0; i<m_npages; i++)
+			if (m_pages[i])
+				free_page(m_pages[i]);
+		delete[] m_pages;
+	}
+
+	size_t	nwords(void) const { return m_nwords; }
+	size_t	npages(void) const { return m_npages; }
+	size_t	pagewords(void) const { return 1ul<<m_lgpage; }
+	bool	huge(void) const { return m_huge; }
+	// Number of pages actually backed by host memory
+	size_t	allocated(void) const { return m_nalloc; }
+
+	// Page pointer for a page index, NULL if it was never written
+	const uint16_t	*peek(size_t pg) const { return m_pages[pg]; }
+
+	// Page pointer for a page index, allocating it if needed
+	uint16_t	*page(size_t pg) {
+		assert(pg < m_npages);
+		if (!m_pages[pg]) {
+			m_pages[pg] = alloc_page();
+			assert(m_pages[pg]);
+			m_nalloc++;
+		}
+		return m_pages[pg];
+	}
+
+	// True if a page holds nothing but zeros
+	bool	zero(size_t pg) const {
+		const uint16_t	*p = m_pages[pg];
+
+		if (!p)
+			return true;
+		for(size_t i=0; i<(1ul<<m_lgpage); i++)
+			if (p[i])
+				return false;
+		return true;
+	}
+
+	uint16_t	read(size_t w) const {
+		const uint16_t	*p = m_pages[w >> m_lgpage];
+
+		return (p) ? p[w & ((1ul<<m_lgpage)-1)] : 0;
+	}
+
+	// Bulk copy of a little-endian byte image starting at byte offset
+	// "off".  The words are stored in host order, so on a little-endian
+	// host the image is just copied page by page.
+	void	load(size_t off, const void *data, size_t len) {
+		const char	*sp = (const char *)data;
+		size_t		pgbytes = sizeof(uint16_t) << m_lgpage;
+
+		assert(off + len <= m_nwords * sizeof(uint16_t));
+		while(len > 0) {
+			size_t	pg = off / pgbytes, po = off % pgbytes;
+			size_t	n  = pgbytes - po;
+			if (n > len)
+				n = len;
+			memcpy((char *)page(pg) + po, sp, n);
+			sp += n; off += n; len -= n;
+		}
+	}
+
+	// Copy a byte range out, little-endian like load().  Pages never
+	// written read as zeros.
+	void	dump(size_t off, void *data, size_t len) const {
+		char		*dp = (char *)data;
+		size_t		pgbytes = sizeof(uint16_t) << m_lgpage;
+
+		assert(off + len <= m_nwords * sizeof(uint16_t));
+		while(len > 0) {
+			size_t	pg = off / pgbytes, po = off % pgbytes;
+			size_t	n  = pgbytes - po;
+			if (n > len)
+				n = len;
+			if (m_pages[pg])
+				memcpy(dp, (const char *)m_pages[pg] + po, n);
+			else
+				memset(dp, 0, n);
+			dp += n; off += n; len -= n;
+		}
+	}
+
+	// Zero a byte range, without allocating pages that are still clear
+	void	clear(size_t off, size_t len) {
+		size_t		pgbytes = sizeof(uint16_t) << m_lgpage;
+
+		assert(off + len <= m_nwords * sizeof(uint16_t));
+		while(len > 0) {
+			size_t	pg = off / pgbytes, po = off % pgbytes;
+			size_t	n  = pgbytes - po;
+			if (n > len)
+				n = len;
+			if (m_pages[pg])
+				memset((char *)m_pages[pg] + po, 0, n);
+			off += n; len -= n;
+		}
+	}
+
+	// FNV-1a hash of the contents, in 4kB blocks with their offsets.  All
+	// zero blocks are left out, so the hash does not depend on the page
+	// size or on which pages happen to be allocated.
+	uint64_t	hash(void) const {
+		const size_t	blkwords = 2048;
+		uint64_t	h = 0xcbf29ce484222325ull;
+
+		for(size_t pg=0; pg<m_npages; pg++) {
+			const uint16_t	*p = m_pages[pg];
+			if (!p)
+				continue;
+			for(size_t b=0; b<(1ul<<m_lgpage); b+=blkwords) {
+				const uint8_t	*bp = (const uint8_t *)(p + b);
+				uint64_t	off = ((pg << m_lgpage) + b) * sizeof(uint16_t);
+				size_t		i;
+
+				for(i=0; i<blkwords; i++)
+					if (p[b+i])
+						break;
+				if (i == blkwords)
+					continue;
+				for(i=0; i<sizeof(off); i++)
+					h = (h ^ ((off >> (8*i)) & 0x0ff)) * 0x100000001b3ull;
+				for(i=0; i<blkwords*sizeof(uint16_t); i++)
+					h = (h ^ bp[i]) * 0x100000001b3ull;
+			}
+		}
+		return h;
+	}
+
+	// Snapshot: the page size, then byte offset and contents of every
+	// page with anything other than zeros in it
+	void	save(FILE *fp) const {
+		uint64_t	pgbytes = sizeof(uint16_t) << m_lgpage, n = 0;
+
+		for(size_t pg=0; pg<m_npages; pg++)
+			if (!zero(pg))
+				n++;
+		fwrite(&pgbytes, sizeof(pgbytes), 1, fp);
+		fwrite(&n, sizeof(n), 1, fp);
+		for(size_t pg=0; pg<m_npages; pg++) {
+			uint64_t	off = pg * pgbytes;
+			if (zero(pg))
+				continue;
+			fwrite(&off, sizeof(off), 1, fp);
+			fwrite(m_pages[pg], pgbytes, 1, fp);
+		}
+	}
+
+	// Replace the contents with a snapshot.  The snapshot may have been
+	// taken with the other page size.
+	bool	restore(FILE *fp) {
+		uint64_t	pgbytes, n, off;
+		char		*buf;
+		bool		ok = true;
+
+		if ((fread(&pgbytes, sizeof(pgbytes), 1, fp) != 1)
+				||(fread(&n, sizeof(n), 1, fp) != 1)
+				||(pgbytes == 0)||(pgbytes > (64u<<20)))
+			return false;
+		clear(0, m_nwords * sizeof(uint16_t));
+		buf = new char[pgbytes];
+		for(; (ok)&&(n > 0); n--) {
+			ok = (fread(&off, sizeof(off), 1, fp) == 1)
+				&&(fread(buf, pgbytes, 1, fp) == 1)
+				&&(off + pgbytes <= m_nwords * sizeof(uint16_t));
+			if (ok)
+				load(off, buf, pgbytes);
+		}
+		delete[] buf;
+		return ok;
+	}
+
+	void	write(size_t w, uint16_t v) {
+		uint16_t	*p = m_pages[w >> m_lgpage];
+
+		if (!p) {
+			// Writing zero to an untouched page changes nothing
+			if (v == 0)
+				return;
+			p = page(w >> m_lgpage);
+		}
+		p[w & ((1ul<<m_lgpage)-1)] = v;
+	}
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef	SDRAMTRACE_H
+#define	SDRAMTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Transaction tracing for the SDRAM model.
+//
+//   SDRAMTRACE_OFF      nothing is recorded
+//   SDRAMTRACE_SUMMARY  only per-operation totals, printed at the end
+//   SDRAMTRACE_FULL     every command and data beat is written as a
+//                       fixed-size binary record to a file
+//
+// Full traces go through an in-memory ring of records.  The simulation
+// only copies the record in; a writer thread drains the ring to the file
+// one chunk at a time, so the simulation never waits on I/O unless the
+// disk cannot keep up with it.  The sdramtrace host tool turns a trace
+// file back into text.
+#define	SDRAMTRACE_OFF		0
+#define	SDRAMTRACE_SUMMARY	1
+#define	SDRAMTRACE_FULL		2
+
+#define	SDRAMTRACE_MAGIC	"SDRTRC01"
+
+enum	SDRAMTRACE_OP {
+	SDRAMTRACE_ACT = 0,	// addr = row
+	SDRAMTRACE_PRE,		// single bank precharge
+	SDRAMTRACE_PREALL,	// precharge all banks
+	SDRAMTRACE_REF,		// auto refresh
+	SDRAMTRACE_MODE,	// addr = mode register value
+	SDRAMTRACE_RD,		// read beat: addr = word address, data = word
+	SDRAMTRACE_WR,		// write beat: addr = word address, data, dqm
+	SDRAMTRACE_NOPS
+};
+
+struct	SDRAMTRACE_REC {
+	uint64_t	tick;
+	uint32_t	addr;
+	uint32_t	data;
+	uint8_t		op;
+	uint8_t		bank;
+	uint8_t		dqm;
+	uint8_t		rsvd[5];
+};
+
+struct	SDRAMTRACE_HDR {
+	char		magic[8];
+	uint32_t	recsize;
+	uint32_t	rsvd;
+};
+
+class	SDRAMTRACE {
+	int		m_level;
+	uint64_t	m_count[SDRAMTRACE_NOPS];
+
+	// Ring buffer, in chunks of CHUNK records
+	static const unsigned	CHUNK   = 1<<14;
+	static const unsigned	NCHUNKS = 64;	// 24MB of records
+	SDRAMTRACE_REC	*m_ring;
+	// Records produced and records written.  The writer always starts on
+	// a chunk boundary, so a chunk it writes never wraps around the ring.
+	std::atomic<uint64_t>	m_head, m_tail;
+	FILE		*m_fp;
+	bool		m_done;
+	std::mutex	m_lock;
+	std::condition_variable	m_cv;
+	std::thread	m_writer;
+
+	void	writer(void) {
+		std::unique_lock<std::mutex>	lk(m_lock);
+
+		for(;;) {
+			m_cv.wait(lk, [this]{
+				return (m_done)||(m_head - m_tail >= CHUNK); });
+			if ((m_done)&&(m_head == m_tail))
+				break;
+
+			uint64_t	tail = m_tail;
+			unsigned	n = (unsigned)(m_head - tail);
+			if (n > CHUNK)
+				n = CHUNK;
+			lk.unlock();
+			fwrite(&m_ring[tail % (CHUNK*NCHUNKS)], sizeof(SDRAMTRACE_REC), n, m_fp);
+			lk.lock();
+			m_tail = tail + n;
+			m_cv.notify_all();
+		}
+	}
+
+public:
+	static const char *opname(unsigned op) {
+		static const char *names[SDRAMTRACE_NOPS] = {
+			"ACT", "PRE", "PREALL", "REF", "MODE", "RD", "WR" };
+		return (op < SDRAMTRACE_NOPS) ? names[op] : "???";
+	}
+
+	SDRAMTRACE(int level, const char *fname = NULL) {
+		m_level = level;
+		m_ring  = NULL;
+		m_fp    = NULL;
+		m_head  = 0;
+		m_tail  = 0;
+		m_done  = false;
+		memset(m_count, 0, sizeof(m_count));
+
+		if (m_level >= SDRAMTRACE_FULL) {
+			SDRAMTRACE_HDR	hdr;
+
+			m_fp = fopen(fname, "wb");
+			if (!m_fp) {
+				fprintf(stderr, "SDRAM: cannot create trace %s, tracing summary only\n", fname);
+				m_level = SDRAMTRACE_SUMMARY;
+				return;
+			}
+			memset(&hdr, 0, sizeof(hdr));
+			memcpy(hdr.magic, SDRAMTRACE_MAGIC, sizeof(hdr.magic));
+			hdr.recsize = sizeof(SDRAMTRACE_REC);
+			fwrite(&hdr, sizeof(hdr), 1, m_fp);
+
+			m_ring = new SDRAMTRACE_REC[CHUNK*NCHUNKS];
+			m_writer = std::thread(&SDRAMTRACE::writer, this);
+		}
+	}
+
+	~SDRAMTRACE(void) {
+		close();
+	}
+
+	int	level(void) const { return m_level; }
+	uint64_t	count(unsigned op) const { return m_count[op]; }
+
+	void	record(uint64_t tick, unsigned op, unsigned bank,
+			uint32_t addr, uint32_t data = 0, unsigned dqm = 0) {
+		m_count[op]++;
+		if (m_level < SDRAMTRACE_FULL)
+			return;
+
+		// Wait for the writer only if the whole ring is pending
+		if (m_head - m_tail >= CHUNK*(NCHUNKS-1)) {
+			std::unique_lock<std::mutex>	lk(m_lock);
+			m_cv.wait(lk, [this]{
+				return m_head - m_tail < CHUNK*(NCHUNKS-1); });
+		}
+
+		SDRAMTRACE_REC	&r = m_ring[m_head % (CHUNK*NCHUNKS)];
+		r.tick = tick;
+		r.addr = addr;
+		r.data = data;
+		r.op   = op;
+		r.bank = bank;
+		r.dqm  = dqm;
+		memset(r.rsvd, 0, sizeof(r.rsvd));
+
+		if (((m_head+1) % CHUNK) == 0) {
+			std::lock_guard<std::mutex>	lk(m_lock);
+			m_head++;
+			m_cv.notify_all();
+		} else
+			m_head++;
+	}
+
+	// Drain everything still in the ring and stop the writer
+	void	close(void) {
+		if (!m_fp)
+			return;
+		{
+			std::lock_guard<std::mutex>	lk(m_lock);
+			m_done = true;
+			m_cv.notify_all();
+		}
+		m_writer.join();
+		fclose(m_fp);
+		m_fp = NULL;
+		delete[] m_ring;
+		m_ring = NULL;
+	}
+
+	void	summary(FILE *fp, const char *name) const {
+		if (m_level < SDRAMTRACE_SUMMARY)
+			return;
+		fprintf(fp, "%s: ", name);
+		for(unsigned op=0; op<SDRAMTRACE_NOPS; op++)
+			fprintf(fp, "%s%s=%lu", (op)?", ":"", opname(op),
+				(unsigned long)m_count[op]);
+		fprintf(fp, "\n");
+	}
+};
+
+#endif
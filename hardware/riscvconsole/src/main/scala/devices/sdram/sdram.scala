@@ -2,11 +2,12 @@ package riscvconsole.devices.sdram
 
 import chisel3._
 import chisel3.experimental.{Analog, IntParam, StringParam, attach}
-import chisel3.util.{HasBlackBoxResource, RegEnable}
+import chisel3.util.{HasBlackBoxResource, Queue}
 import freechips.rocketchip.config._
 import freechips.rocketchip.diplomacy._
 import freechips.rocketchip.prci.{ClockGroup, ClockSinkDomain}
-import freechips.rocketchip.subsystem.{Attachable, BaseSubsystem, MBUS, SBUS}
+import freechips.rocketchip.regmapper.{RegField, RegFieldDesc}
+import freechips.rocketchip.subsystem.{Attachable, BaseSubsystem, MBUS, PBUS, SBUS, TLBusWrapperLocation}
 import freechips.rocketchip.tilelink._
 import freechips.rocketchip.util.HeterogeneousBag
 
@@ -18,16 +19,50 @@ case class sdram_bb_cfg
   SDRAM_BANK_W: Int = 2,
   SDRAM_DQM_W: Int = 2,
   SDRAM_DQ_W: Int = 16,
-  SDRAM_READ_LATENCY: Int  = 3
+  SDRAM_READ_LATENCY: Int  = 3,
+  SDRAM_FAST_INIT: Boolean = false, // Simulation only: skip the 100uS power up wait
+  SDRAM_ADDR_MAP: Int = SDRAMAddrMap.RBC,
+  SDRAM_REFRESH_POSTPONE: Int = 8 // Refreshes that may wait for idle (0 to 8)
 ) {
+  require(SDRAMAddrMap.all.contains(SDRAM_ADDR_MAP))
+  require(SDRAM_REFRESH_POSTPONE >= 0 && SDRAM_REFRESH_POSTPONE <= 8)
   val SDRAM_MHZ = SDRAM_HZ/1000000
   val SDRAM_BANKS = 1 << SDRAM_BANK_W
   val SDRAM_ROW_W = SDRAM_ADDR_W - SDRAM_COL_W - SDRAM_BANK_W
   val SDRAM_REFRESH_CNT = 1 << SDRAM_ROW_W
-  val SDRAM_START_DELAY = 100000 / (1000 / SDRAM_MHZ) // 100 uS
+  val SDRAM_START_DELAY = if (SDRAM_FAST_INIT) 0 else 100000 / (1000 / SDRAM_MHZ) // 100 uS
   val SDRAM_REFRESH_CYCLES = (64000*SDRAM_MHZ) / SDRAM_REFRESH_CNT-1
 }
 
+// Address bits to SDRAM row, bank and column, from the bottom up: column
+// always, then
+//   RBC: bank, row (rows of all banks interleave)
+//   BRC: row, bank (each bank is a contiguous quarter of the memory)
+//   XOR: as RBC, with the bank bits XOR the low row bits, so addresses
+//        that only differ in those row bits land in different banks
+object SDRAMAddrMap {
+  val RBC = 0
+  val BRC = 1
+  val XOR = 2
+  val all = Seq(RBC, BRC, XOR)
+
+  // Bank and row of a byte address, decoded as sdram.v does. Columns are
+  // 16 bits whatever the DQ width (a wider bus is chips side by side,
+  // picked by the bits above the row), so the column is bits COL_W to 1
+  def bankRow(cfg: sdram_bb_cfg, addr: UInt): (UInt, UInt) = {
+    val aw = cfg.SDRAM_ADDR_W
+    val cw = cfg.SDRAM_COL_W
+    val bw = cfg.SDRAM_BANK_W
+    if (cfg.SDRAM_ADDR_MAP == BRC) {
+      (addr(aw, aw - bw + 1), addr(aw - bw, cw + 1))
+    } else {
+      val row = addr(aw, cw + bw + 1)
+      val bank = addr(cw + bw, cw + 1)
+      (if (cfg.SDRAM_ADDR_MAP == XOR) bank ^ row(bw - 1, 0) else bank, row)
+    }
+  }
+}
+
 trait HasSDRAMIf{
   this: Bundle =>
   val cfg: sdram_bb_cfg
@@ -60,6 +95,8 @@ trait HasWishboneIf{
   val ack_o = Output(Bool())
 }
 
+class WishboneIf extends Bundle with HasWishboneIf
+
 class sdram(val cfg: sdram_bb_cfg) extends BlackBox (
   Map(
     "SDRAM_MHZ" -> IntParam(cfg.SDRAM_MHZ),
@@ -73,12 +110,19 @@ class sdram(val cfg: sdram_bb_cfg) extends BlackBox (
     "SDRAM_REFRESH_CNT" -> IntParam(cfg.SDRAM_REFRESH_CNT),
     "SDRAM_START_DELAY" -> IntParam(cfg.SDRAM_START_DELAY),
     "SDRAM_REFRESH_CYCLES" -> IntParam(cfg.SDRAM_REFRESH_CYCLES),
-    "SDRAM_READ_LATENCY" -> IntParam(cfg.SDRAM_READ_LATENCY)
+    "SDRAM_READ_LATENCY" -> IntParam(cfg.SDRAM_READ_LATENCY),
+    "SDRAM_ADDR_MAP" -> IntParam(cfg.SDRAM_ADDR_MAP),
+    "SDRAM_REFRESH_POSTPONE" -> IntParam(cfg.SDRAM_REFRESH_POSTPONE)
   )
 ) with HasBlackBoxResource {
   val io = IO(new SDRAMIf(cfg) with HasWishboneIf {
     val clk_i = Input(Clock())
     val rst_i = Input(Bool())
+    val evt_read_o = Output(Bool())
+    val evt_write_o = Output(Bool())
+    val evt_row_hit_o = Output(Bool())
+    val evt_row_miss_o = Output(Bool())
+    val evt_refresh_o = Output(Bool())
   })
   addResource("/sdram/sdram.v")
 }
@@ -88,45 +132,88 @@ class sdram(val cfg: sdram_bb_cfg) extends BlackBox (
 case class SDRAMConfig // Periphery Config
 (
   address: BigInt,
-  sdcfg: sdram_bb_cfg = sdram_bb_cfg()
+  sdcfg: sdram_bb_cfg = sdram_bb_cfg(),
+  simFunctional: Boolean = false, // Simulation only: the TL port can bypass the controller (see sdramfunc)
+  // Wishbone pipeline in front of the controller, off unless a board turns
+  // it on (WithSDRAMPipeline)
+  maxInFlight: Int = 1, // Wishbone accesses accepted and waiting for their response
+  writeBuffer: Int = 0, // Posted write entries (words) in front of the controller, 0 for none
+  prefetch: Int = 0, // Words read ahead of sequential reads, 0 for none
+  perfAddress: Option[BigInt] = None, // Performance counters (SDRAMPerfRegs)
+  // Arbitration of the TL ports: the MBUS one first, then the DMA ports
+  // (SDRAM.dmaXing) for masters to connect to
+  ports: Seq[SDRAMPortParams] = Seq(SDRAMPortParams()),
+  // From the MBUS: synchronous when the SDRAM runs on the MBUS clock, else
+  // otherclock, rational if an integer ratio of the MBUS clock (its
+  // direction tells which is faster)
+  crossing: ClockCrossingType = AsynchronousCrossing()
 ) {
+  require(ports.nonEmpty)
   val size: BigInt = (1 << sdcfg.SDRAM_ADDR_W) * sdcfg.SDRAM_DQ_W / 8
   //0x2000000L, // 32Mb (256Mbits)
   //0x4000000L, // 64Mb (512Mbits)
 }
 
-class SDRAM(cfg: SDRAMConfig, blockBytes: Int, beatBytes: Int)(implicit p: Parameters) extends LazyModule with HasClockDomainCrossing{
+class SDRAM(cfg: SDRAMConfig, blockBytes: Int, beatBytes: Int, ctrlBeatBytes: Int)(implicit p: Parameters) extends LazyModule with HasClockDomainCrossing{
 
   val device = new MemoryDevice
-  val tlcfg = TLSlaveParameters.v1(
+  def tlcfg(resources: Seq[Resource]) = TLSlaveParameters.v1(
     address             = AddressSet.misaligned(cfg.address, cfg.size),
-    resources           = device.reg,
-    regionType          = RegionType.UNCACHED, // cacheable
+    resources           = resources,
+    // Memory as seen from the bus: the coherence manager above it is what
+    // lets the L1s cache it, and this manager does not do Acquire
+    regionType          = RegionType.UNCACHED,
     executable          = true,
-    supportsGet         = TransferSizes(1, 4), // 1, 128
-    supportsPutFull     = TransferSizes(1, 4),
-    supportsPutPartial  = TransferSizes(1, 4),
+    supportsGet         = TransferSizes(1, blockBytes), // Whole cache lines, as bursts
+    supportsPutFull     = TransferSizes(1, blockBytes),
+    supportsPutPartial  = TransferSizes(1, blockBytes),
     fifoId              = Some(0)
   )
   val tlportcfg = TLSlavePortParameters.v1(
-    managers = Seq(tlcfg),
+    managers = Seq(tlcfg(device.reg)),
+    beatBytes = 4
+  )
+  // The DMA ports reach the same memory, already in the DTS
+  val dmaportcfg = TLSlavePortParameters.v1(
+    managers = Seq(tlcfg(Nil)),
     beatBytes = 4
   )
   val sdramnode = TLManagerNode(Seq(tlportcfg))
   val node = TLBuffer()
+  val dmasdramnodes = cfg.ports.tail.map(_ => TLManagerNode(Seq(dmaportcfg)))
+  val dmanodes = cfg.ports.tail.map(_ => TLBuffer())
 
   // Create the IO node, and stop trying to get something from elsewhere
   val ioNode = BundleBridgeSource(() => (new SDRAMIf(cfg.sdcfg)).cloneType)
   val port = InModuleBody { ioNode.bundle }
 
   // Connections of the node
-  sdramnode := TLFragmenter(4, blockBytes) := TLWidthWidget(beatBytes) := node
+  sdramnode := TLWidthWidget(beatBytes) := node
+
+  (dmasdramnodes zip dmanodes).foreach { case (m, n) => m := TLWidthWidget(beatBytes) := n }
 
   val controlXing: TLInwardClockCrossingHelper = this.crossIn(node)
+  val dmaXing: Seq[TLInwardClockCrossingHelper] = dmanodes.map(this.crossIn(_))
+
+  // Performance counters
+  val perfnode = cfg.perfAddress.map { addr =>
+    val device = new SimpleDevice("sdram-perf", Seq("console,sdramperf0"))
+    TLRegisterNode(
+      address = Seq(AddressSet(addr, 0xfff)),
+      device = device,
+      beatBytes = ctrlBeatBytes)
+  }
+  val perfXing: Option[TLInwardClockCrossingHelper] = perfnode.map(this.crossIn(_))
 
   lazy val module = new LazyModuleImp(this) {
     val sdramimp = Module(new sdram(cfg.sdcfg))
 
+    // Simulation only: functional port serving the accesses from the SDRAM
+    // model memory while its mode is set. The controller keeps refreshing.
+    val func = if (cfg.simFunctional) Some(Module(new sdramfunc(cfg.address))) else None
+    val functional = func.map(_.io.functional).getOrElse(false.B)
+    val stall = sdramimp.io.stall_o && !functional
+
     // Clock and Reset
     sdramimp.io.clk_i := clock
     sdramimp.io.rst_i := reset.asBool()
@@ -149,58 +236,125 @@ class SDRAM(cfg: SDRAMConfig, blockBytes: Int, beatBytes: Int)(implicit p: Param
     // Obtain the TL bundle
     val (tl_in, tl_edge) = sdramnode.in(0) // Extract the port from the node
 
-    // Flow control
-    val d_full = RegInit(false.B) // Transaction pending
-    val d_valid_held = RegInit(false.B) // Held valid of D channel if not ready
-    val d_size = Reg(UInt()) // Saved size
-    val d_source = Reg(UInt()) // Saved source
-    val d_hasData = Reg(Bool()) // Saved source
-
-    // d_full logic: It is full if there is 1 transaction not completed
-    // this is, of course, waiting until D responses for every individual A transaction
-    when (tl_in.d.fire()) { d_full := false.B }
-    when (tl_in.a.fire() && !sdramimp.io.stall_o) { d_full := true.B }
-
-    // The D valid is the WB ack and the valid held (if D not ready yet)
-    tl_in.d.valid := d_valid_held
-    // Try to latch true the D valid held.
-    // If we use fire for the "false" latch, it lasts at least 1 cycle
-    val ack = (sdramimp.io.ack_o)
-    when(ack) { d_valid_held := true.B }
-    when(tl_in.d.fire()) { d_valid_held := false.B }
-
-    // The A ready should be 1 only if there is no transaction
-    tl_in.a.ready := !d_full && !sdramimp.io.stall_o
-
-    // hasData helds if there is a write transaction
-    val hasData = tl_edge.hasData(tl_in.a.bits)
-
-    // Response data to D
-    val d_data = RegEnable(sdramimp.io.data_o, ack)
-
-    // Save the size and the source from the A channel for the D channel
-    when (tl_in.a.fire()) {
-      d_size   := tl_in.a.bits.size
-      d_source := tl_in.a.bits.source
-      d_hasData := hasData
+    // Pipelined adapter: keeps accepting A requests while earlier ones
+    // wait for their ack, and turns bursts into back to back accesses
+    val wb = Module(new TLToWishbone(tl_edge, cfg.maxInFlight))
+    wb.io.tl <> tl_in
+    val dmawb = dmasdramnodes.map { n =>
+      val (tl, edge) = n.in(0)
+      val m = Module(new TLToWishbone(edge, cfg.maxInFlight))
+      m.io.tl <> tl
+      m
     }
 
-    // Response characteristics
-    tl_in.d.bits := tl_edge.AccessAck(d_source, d_size, d_data)
-    tl_in.d.bits.opcode := Mux(d_hasData, TLMessages.AccessAck, TLMessages.AccessAckData)
+    // Ports one access at a time, by class, priority and reserved share
+    val arb = if (dmawb.nonEmpty) Some(Module(new WishboneArbiter(cfg.ports, cfg.maxInFlight))) else None
+    arb.foreach { a => (a.io.in zip (wb +: dmawb)).foreach { case (i, m) => i <> m.io.wb } }
+    val wbOut = arb.map(_.io.out).getOrElse(wb.io.wb)
+
+    // Posted writes: acked as soon as they are buffered, partial writes to
+    // the same word merged, and written back on open row hits
+    val wbuf = if (cfg.writeBuffer > 0) Some(Module(new WishboneWriteBuffer(cfg.writeBuffer, cfg.maxInFlight, cfg.sdcfg))) else None
+    wbuf.foreach(_.io.in <> wbOut)
+    val wbufOut = wbuf.map(_.io.out).getOrElse(wbOut)
+
+    // Reads ahead of sequential reads, served in a clock once there
+    val pf = if (cfg.prefetch > 0) Some(Module(new WishbonePrefetch(cfg.prefetch, cfg.maxInFlight))) else None
+    pf.foreach(_.io.in <> wbufOut)
+    val bus = pf.map(_.io.out).getOrElse(wbufOut)
+    val idle = (wb +: dmawb).map(_.io.idle).reduce(_ && _) && arb.map(_.io.idle).getOrElse(true.B) &&
+      wbuf.map(_.io.idle).getOrElse(true.B) && pf.map(_.io.idle).getOrElse(true.B)
 
     // Connections to the wb transactions
-    sdramimp.io.stb_i := tl_in.a.valid & !d_full // We trigger the transaction only here
-    sdramimp.io.cyc_i := tl_in.a.valid & !d_full // We trigger the transaction only here
-    sdramimp.io.addr_i := tl_in.a.bits.address
-    sdramimp.io.data_i := tl_in.a.bits.data
-    sdramimp.io.we_i := hasData // Is write?
-    sdramimp.io.sel_i := tl_in.a.bits.mask
-
-    // Tie off unused channels
-    tl_in.b.valid := false.B
-    tl_in.c.ready := true.B
-    tl_in.e.ready := true.B
+    sdramimp.io.stb_i := bus.stb_i & !functional
+    sdramimp.io.cyc_i := bus.cyc_i & !functional
+    sdramimp.io.addr_i := bus.addr_i
+    sdramimp.io.data_i := bus.data_i
+    sdramimp.io.we_i := bus.we_i
+    sdramimp.io.sel_i := bus.sel_i
+    bus.stall_o := stall
+    bus.ack_o := Mux(functional, func.map(_.io.ack).getOrElse(false.B), sdramimp.io.ack_o)
+    bus.data_o := Mux(functional, func.map(_.io.rdata).getOrElse(0.U), sdramimp.io.data_o)
+
+    // Connections to the functional port. It never stalls, and only
+    // switches modes with nothing in flight, buffered or offered
+    func.foreach { f =>
+      f.io.clock := clock
+      f.io.reset := reset.asBool()
+      f.io.req := bus.stb_i && functional
+      f.io.we := bus.we_i
+      f.io.addr := bus.addr_i
+      f.io.mask := bus.sel_i
+      f.io.wdata := bus.data_i
+      f.io.idle := idle
+    }
+
+    // Performance counters. The TL latency, of the MBUS port, goes from
+    // the first beat of a request offered to the last beat of its response
+    // taken, in SDRAM clocks. It is taken on this side of controlXing, so
+    // the crossing itself is not counted: it tells the controller and its
+    // Wishbone stages apart, not one crossing from another
+    perfnode.foreach { regnode =>
+      val counters = Module(new SDRAMPerfCounters(cfg.prefetch, cfg.ports.size))
+      val freeze = RegInit(false.B)
+      val clear = WireInit(false.B)
+
+      val now = RegInit(0.U(32.W))
+      now := now + 1.U
+      val a_first = tl_edge.first(tl_in.a)
+      val a_held = RegInit(false.B) // First beat offered, and not taken yet
+      val a_time = Reg(UInt(32.W))
+      when (tl_in.a.valid && a_first && !a_held) { a_time := now }
+      a_held := tl_in.a.valid && a_first && !tl_in.a.fire()
+      // Requests in flight, in order (fifoId)
+      val start = Module(new Queue(UInt(32.W), cfg.maxInFlight + 1))
+      start.io.enq.valid := tl_in.a.fire() && a_first
+      start.io.enq.bits := Mux(a_held, a_time, now)
+      start.io.deq.ready := tl_in.d.fire() && tl_edge.last(tl_in.d)
+      assert(!start.io.enq.valid || start.io.enq.ready, "SDRAM perf: too many requests in flight")
+
+      val e = counters.io.events
+      e.read := sdramimp.io.evt_read_o
+      e.write := sdramimp.io.evt_write_o
+      e.row_hit := sdramimp.io.evt_row_hit_o
+      e.row_miss := sdramimp.io.evt_row_miss_o
+      e.refresh := sdramimp.io.evt_refresh_o
+      e.stall := bus.stb_i && stall
+      e.lat.valid := start.io.deq.fire()
+      e.lat.bits := now - start.io.deq.bits
+      e.pf := pf.map(_.io.events).getOrElse(0.U.asTypeOf(e.pf))
+      e.starve := arb.map(_.io.starve).getOrElse(0.U.asTypeOf(e.starve))
+      counters.io.freeze := freeze
+      counters.io.clear := clear
+
+      def reg64(c: UInt, name: String, desc: String) = Seq(
+        RegField.r(32, c(31, 0), RegFieldDesc(s"${name}_lo", desc)),
+        RegField.r(32, c(63, 32), RegFieldDesc(s"${name}_hi", desc)))
+      val names = Seq(
+        "cycles" -> "Clocks counted",
+        "reads" -> "READ commands",
+        "writes" -> "WRITE commands",
+        "row_hit" -> "READ / WRITE to an open row",
+        "row_miss" -> "READ / WRITE after an ACTIVATE",
+        "refresh" -> "Auto refreshes",
+        "stall" -> "Clocks with a request stalled",
+        "lat_sum" -> "TL latency past the crossing, total clocks",
+        "lat_count" -> "TL requests done",
+        "lat_max" -> "TL latency past the crossing, longest",
+        "pf_hit" -> "Prefetch buffer hits",
+        "pf_miss" -> "Prefetch buffer misses",
+        "pf_issue" -> "Prefetch reads",
+        "pf_drop" -> "Prefetched words not used") ++
+        cfg.ports.indices.map(i => s"starve_$i" -> s"Port $i, clocks waiting for another port")
+      val mapping = Seq(
+        SDRAMPerfRegs.ctrl -> Seq(
+          RegField(1, freeze, RegFieldDesc("freeze", "Stop counting")),
+          RegField(1, clear, RegFieldDesc("clear", "Clear the counters")))
+      ) ++ names.zipWithIndex.map { case ((name, desc), i) =>
+        (SDRAMPerfRegs.cycles + 8 * i) -> reg64(counters.io.counters(i), name, desc)
+      }
+      regnode.regmap(mapping :_*)
+    }
   }
 }
 
@@ -215,14 +369,16 @@ object SDRAMObject {
 case class SDRAMAttachParams
 (
   device: SDRAMConfig,
-  controlXType: ClockCrossingType = AsynchronousCrossing()
+  controlXType: ClockCrossingType = AsynchronousCrossing(),
+  perfWhere: TLBusWrapperLocation = PBUS
 ){
 
   def attachTo(where: Attachable)(implicit p: Parameters): SDRAM = where {
     val name = s"sdram_${SDRAMObject.nextId()}"
     val mbus = where.locateTLBusWrapper(MBUS)
     val sdramClockDomainWrapper = LazyModule(new ClockSinkDomain(take = None))
-    val sdram = sdramClockDomainWrapper { LazyModule(new SDRAM(device, mbus.blockBytes, mbus.beatBytes)) }
+    val pbus = where.locateTLBusWrapper(perfWhere)
+    val sdram = sdramClockDomainWrapper { LazyModule(new SDRAM(device, mbus.blockBytes, mbus.beatBytes, pbus.beatBytes)) }
     sdram.suggestName(name)
 
     mbus.coupleTo(s"mem_${name}") { bus =>
@@ -230,9 +386,8 @@ case class SDRAMAttachParams
         case _: SynchronousCrossing =>
           mbus.dtsClk.map(_.bind(sdram.device))
           mbus.fixedClockNode
-        case _: RationalCrossing =>
-          mbus.clockNode
-        case _: AsynchronousCrossing =>
+        case _: RationalCrossing | _: AsynchronousCrossing =>
+          // Its own clock, otherclock of RVCSystem
           val sdramClockGroup = ClockGroup()
           sdramClockGroup := where.asyncClockGroupsNode
           sdramClockGroup
@@ -241,6 +396,12 @@ case class SDRAMAttachParams
       sdram.controlXing(controlXType) := bus
     }
 
+    sdram.perfXing.foreach { xing =>
+      pbus.coupleTo(s"device_named_${name}_perf") { bus =>
+        xing(controlXType) := TLFragmenter(pbus) := bus
+      }
+    }
+
     sdram
   }
 }
@@ -249,7 +410,7 @@ case object SDRAMKey extends Field[Seq[SDRAMConfig]](Nil)
 
 trait HasSDRAM { this: BaseSubsystem =>
   val sdramNodes = p(SDRAMKey).map { ps =>
-    SDRAMAttachParams(ps).attachTo(this).ioNode.makeSink()
+    SDRAMAttachParams(ps, ps.crossing).attachTo(this).ioNode.makeSink()
   }
 }
 
@@ -0,0 +1,81 @@
+package riscvconsole.devices.sdram
+
+import chisel3._
+import chisel3.util._
+
+// Performance counter registers, 64 bits each (low word first). A counter
+// read in two halves while counting can tear: freeze them to read a
+// consistent set. The TL latency is that of the MBUS port on the SDRAM
+// side of its clock crossing, in SDRAM clocks.
+object SDRAMPerfRegs {
+  val ctrl      = 0x00 // bit 0: freeze, bit 1: clear (write 1)
+  val cycles    = 0x08 // Clocks counted
+  val reads     = 0x10 // READ commands
+  val writes    = 0x18 // WRITE commands
+  val row_hit   = 0x20 // READ / WRITE to the open row of their bank
+  val row_miss  = 0x28 // READ / WRITE that had to activate their row
+  val refresh   = 0x30 // Auto refreshes
+  val stall     = 0x38 // Clocks with a request stalled by the controller
+  val lat_sum   = 0x40 // TL latency: clocks, all requests
+  val lat_count = 0x48 // TL latency: requests
+  val lat_max   = 0x50 // TL latency: clocks, longest request
+  val pf_hit    = 0x58 // Prefetch buffer: reads served
+  val pf_miss   = 0x60 // Prefetch buffer: reads sent to the controller
+  val pf_issue  = 0x68 // Prefetch buffer: prefetch reads
+  val pf_drop   = 0x70 // Prefetch buffer: prefetched words not used
+  val starve    = 0x78 // + 8 * port: clocks waiting for another port
+  def size(ports: Int) = starve + 8 * ports
+}
+
+class SDRAMPerfEvents(val pfEntries: Int, val ports: Int) extends Bundle {
+  val read = Bool()
+  val write = Bool()
+  val row_hit = Bool()
+  val row_miss = Bool()
+  val refresh = Bool()
+  val stall = Bool()
+  val lat = Valid(UInt(32.W)) // Latency of a TL request, once it is done
+  val pf = new WishbonePrefetchEvents(pfEntries)
+  val starve = Vec(ports, Bool())
+}
+
+// Counters of the SDRAM events, in SDRAMPerfRegs order from cycles on
+class SDRAMPerfCounters(pfEntries: Int, ports: Int) extends Module {
+  val io = IO(new Bundle {
+    val events = Input(new SDRAMPerfEvents(pfEntries, ports))
+    val freeze = Input(Bool())
+    val clear = Input(Bool())
+    val counters = Output(Vec((SDRAMPerfRegs.size(ports) - SDRAMPerfRegs.cycles) / 8, UInt(64.W)))
+  })
+
+  def counter(inc: UInt): UInt = {
+    val c = RegInit(0.U(64.W))
+    when (io.clear) { c := 0.U }.elsewhen (!io.freeze) { c := c + inc }
+    c
+  }
+
+  val e = io.events
+  val latMax = RegInit(0.U(64.W))
+  when (io.clear) {
+    latMax := 0.U
+  }.elsewhen (!io.freeze && e.lat.valid && e.lat.bits > latMax) {
+    latMax := e.lat.bits
+  }
+
+  io.counters := VecInit(Seq(
+    counter(1.U),
+    counter(e.read),
+    counter(e.write),
+    counter(e.row_hit),
+    counter(e.row_miss),
+    counter(e.refresh),
+    counter(e.stall),
+    counter(Mux(e.lat.valid, e.lat.bits, 0.U)),
+    counter(e.lat.valid),
+    latMax,
+    counter(e.pf.hit),
+    counter(e.pf.miss),
+    counter(e.pf.issue),
+    counter(e.pf.drop)
+  ) ++ e.starve.map(counter(_)))
+}
@@ -4,10 +4,18 @@ import chisel3._
 import chisel3.experimental.{Analog, IntParam, StringParam, attach}
 import chisel3.util._
 
-class sdramsim(val cfg: sdram_bb_cfg) extends BlackBox(
+class sdramsim(val cfg: sdram_bb_cfg, val base: BigInt = 0) extends BlackBox(
   Map(
     "SDRAM_DATA_W" -> IntParam(cfg.SDRAM_DQ_W),
-    "SDRAM_DQM_W" -> IntParam(cfg.SDRAM_DQM_W)
+    "SDRAM_DQM_W" -> IntParam(cfg.SDRAM_DQM_W),
+    "SDRAM_ROW_W" -> IntParam(cfg.SDRAM_ROW_W),
+    "SDRAM_BANK_W" -> IntParam(cfg.SDRAM_BANK_W),
+    "SDRAM_COL_W" -> IntParam(cfg.SDRAM_COL_W),
+    "SDRAM_HZ" -> IntParam(cfg.SDRAM_HZ),
+    "SDRAM_FAST_INIT" -> IntParam(if (cfg.SDRAM_FAST_INIT) 1 else 0),
+    "SDRAM_ADDR_MAP" -> IntParam(cfg.SDRAM_ADDR_MAP),
+    "SDRAM_REFRESH_POSTPONE" -> IntParam(cfg.SDRAM_REFRESH_POSTPONE),
+    "SDRAM_BASE" -> IntParam(base)
   )
 )
   with HasBlackBoxResource {
@@ -16,12 +24,20 @@ class sdramsim(val cfg: sdram_bb_cfg) extends BlackBox(
   }))
   addResource("/sdram/sdramsim.v")
   addResource("/sdram/sdramsim.cc")
+  addResource("/sdram/sdramsim_dpi.cc")
+  addResource("/sdram/sdramsim_dpi.h")
   addResource("/sdram/sdramsim.h")
+  addResource("/sdram/sdramcfg.h")
+  addResource("/sdram/sdramstore.h")
+  addResource("/sdram/sdramtrace.h")
+  addResource("/sdram/sdramstats.h")
+  addResource("/sdram/sdramcapture.h")
+  addResource("/sdram/sdramheat.h")
 }
 
 object sdramsim {
-  def apply(io: SDRAMIf, reset: Bool) = {
-    val sdram = Module(new sdramsim(io.cfg))
+  def apply(io: SDRAMIf, reset: Bool, base: BigInt = 0) = {
+    val sdram = Module(new sdramsim(io.cfg, base))
     sdram.io.sdram_clk_o := io.sdram_clk_o
     sdram.io.sdram_cke_o := io.sdram_cke_o
     sdram.io.sdram_cs_o := io.sdram_cs_o
@@ -36,4 +52,28 @@ object sdramsim {
     sdram.io.reset := reset
     io.sdram_data_i := sdram.io.sdram_data_i
   }
-}
\ No newline at end of file
+}
+// Simulation only: functional access to the memory of the sdramsim
+// instance holding the address (see SDRAMConfig.simFunctional)
+class sdramfunc(val base: BigInt = 0) extends BlackBox(
+  Map(
+    "SDRAM_BASE" -> IntParam(base)
+  )
+)
+  with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val req = Input(Bool())
+    val we = Input(Bool())
+    val addr = Input(UInt(32.W))
+    val mask = Input(UInt(4.W))
+    val wdata = Input(UInt(32.W))
+    val idle = Input(Bool())
+    val ack = Output(Bool())
+    val rdata = Output(UInt(32.W))
+    val functional = Output(Bool())
+  })
+  // The DPI side is in sdramsim_dpi.cc, added by the sdramsim holding the memory
+  addResource("/sdram/sdramfunc.v")
+}
@@ -0,0 +1,102 @@
+package riscvconsole.devices.sdram
+
+import chisel3._
+import chisel3.util._
+import freechips.rocketchip.tilelink._
+
+// What the D channel needs from a Wishbone access
+class TLToWishboneMeta(val sourceBits: Int, val sizeBits: Int) extends Bundle {
+  val source = UInt(sourceBits.W)
+  val size = UInt(sizeBits.W)
+  val hasData = Bool()
+  val last = Bool() // Last access of the TL message
+}
+
+class TLToWishboneResp(sourceBits: Int, sizeBits: Int) extends TLToWishboneMeta(sourceBits, sizeBits) {
+  val data = UInt(32.W)
+}
+
+// Pipelined TileLink (TL-UH, 4-byte beats) to Wishbone adapter
+//
+// Every 4-byte beat is one Wishbone access: a Get of N beats issues N
+// reads at consecutive addresses, and a Put of N beats one write per
+// beat. They go to the Wishbone side as they come, whenever the slave
+// does not stall, with up to "depth" of them waiting for their ack or
+// their D beat. The slave acks in request order, so what the D channel
+// needs of every access waits in a queue for its ack. Acks cannot be held
+// back, so the responses are queued too: one D beat per read, and one
+// AccessAck for the last write of a Put.
+class TLToWishbone(edge: TLEdgeIn, depth: Int = 8) extends Module {
+  val io = IO(new Bundle {
+    val tl = Flipped(TLBundle(edge.bundle))
+    val wb = Flipped(new Bundle with HasWishboneIf)
+    val idle = Output(Bool()) // Nothing in flight, and nothing offered
+  })
+
+  require(depth > 0)
+  require(edge.manager.beatBytes == 4)
+
+  val sourceBits = edge.bundle.sourceBits
+  val sizeBits = edge.bundle.sizeBits
+  val meta = Module(new Queue(new TLToWishboneMeta(sourceBits, sizeBits), depth))
+  // Flow through, for the D beat to go out with the ack
+  val resp = Module(new Queue(new TLToWishboneResp(sourceBits, sizeBits), depth, flow = true))
+
+  val a = io.tl.a
+  val d = io.tl.d
+  val hasData = edge.hasData(a.bits)
+
+  // Accesses accepted and not done with: their ack or their D beat is
+  // still to come
+  val inflight = RegInit(0.U(log2Ceil(depth + 1).W))
+  val room = inflight =/= depth.U
+
+  // Beat of the A message. Puts carry it on the A channel, Gets have a
+  // single A beat that stays until all its reads are issued
+  val beat = RegInit(0.U(log2Ceil(edge.maxTransfer / 4 + 1).W))
+  val beats = Mux(a.bits.size > 2.U, UIntToOH(a.bits.size - 2.U), 1.U)
+  val last = beat === beats - 1.U
+
+  // Wishbone request, only with room for its response
+  val accept = a.valid && room && !io.wb.stall_o
+  io.wb.stb_i := a.valid && room
+  io.wb.cyc_i := a.valid && room
+  io.wb.addr_i := a.bits.address | (beat << 2)
+  io.wb.data_i := a.bits.data
+  io.wb.we_i := hasData // Is write?
+  io.wb.sel_i := a.bits.mask
+  a.ready := accept && (hasData || last)
+  when (accept) { beat := Mux(last, 0.U, beat + 1.U) }
+
+  meta.io.enq.valid := accept
+  meta.io.enq.bits.source := a.bits.source
+  meta.io.enq.bits.size := a.bits.size
+  meta.io.enq.bits.hasData := hasData
+  meta.io.enq.bits.last := last
+
+  // Responses, in order. Writes but the last of a Put are done on ack
+  val respond = !meta.io.deq.bits.hasData || meta.io.deq.bits.last
+  resp.io.enq.valid := io.wb.ack_o && respond
+  resp.io.enq.bits.source := meta.io.deq.bits.source
+  resp.io.enq.bits.size := meta.io.deq.bits.size
+  resp.io.enq.bits.hasData := meta.io.deq.bits.hasData
+  resp.io.enq.bits.last := meta.io.deq.bits.last
+  resp.io.enq.bits.data := io.wb.data_o
+  meta.io.deq.ready := io.wb.ack_o
+  assert(!io.wb.ack_o || meta.io.deq.valid, "Wishbone ack with no access in flight")
+  assert(!resp.io.enq.valid || resp.io.enq.ready, "Wishbone ack with no room for the response")
+
+  inflight := inflight + accept.asUInt - (io.wb.ack_o && !respond).asUInt - d.fire().asUInt
+
+  d.valid := resp.io.deq.valid
+  d.bits := edge.AccessAck(resp.io.deq.bits.source, resp.io.deq.bits.size, resp.io.deq.bits.data)
+  d.bits.opcode := Mux(resp.io.deq.bits.hasData, TLMessages.AccessAck, TLMessages.AccessAckData)
+  resp.io.deq.ready := d.ready
+
+  io.idle := inflight === 0.U && !a.valid
+
+  // Tie off unused channels
+  io.tl.b.valid := false.B
+  io.tl.c.ready := true.B
+  io.tl.e.ready := true.B
+}
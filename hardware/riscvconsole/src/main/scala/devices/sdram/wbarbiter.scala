@@ -0,0 +1,107 @@
+package riscvconsole.devices.sdram
+
+import chisel3._
+import chisel3.util._
+
+// Arbitration settings of an SDRAM port
+case class SDRAMPortParams
+(
+  priority: Int = 0, // 0 to 15, higher wins among ports of the same class
+  realtime: Boolean = false, // Wins over every port that is not real time
+  share: Int = 0, // Accesses reserved every "window" clocks, 0 for none
+  window: Int = 64,
+  maxWait: Int = 256 // Clocks waiting before winning over its class
+) {
+  require(priority >= 0 && priority < 16)
+  require(share >= 0 && window > 0 && share <= window)
+  require(maxWait > 0)
+}
+
+// Wishbone arbiter of several masters in front of the SDRAM controller
+//
+// One access is granted per clock, to the requesting port of the highest
+// class, and then the highest priority (the lowest port on a tie). From
+// the top, the classes are:
+//   real time ports
+//   ports that waited maxWait clocks or more
+//   ports with accesses left of their share of the window
+//   the others
+// The slave acks in request order, so the port of every access waits in a
+// queue for its ack. An access the slave stalls keeps the grant until it
+// is taken: arbitration only starts again after that.
+class WishboneArbiter(ports: Seq[SDRAMPortParams], depth: Int) extends Module {
+  val n = ports.size
+  val io = IO(new Bundle {
+    val in = Vec(n, new WishboneIf)
+    val out = Flipped(new WishboneIf)
+    val starve = Output(Vec(n, Bool())) // Waiting for another port
+    val idle = Output(Bool()) // Nothing in flight
+  })
+
+  require(n > 0)
+  require(depth > 0)
+
+  val down = Module(new Queue(UInt(log2Up(n).W), depth))
+
+  val req = VecInit(io.in.map(i => i.stb_i && i.cyc_i))
+  val credits = ports.map(p => RegInit(p.share.U(log2Up(p.share + 1).W)))
+  val waited = ports.map(p => RegInit(0.U(log2Up(p.maxWait + 1).W)))
+
+  val rank = ports.zipWithIndex.map { case (p, i) =>
+    Cat(p.realtime.B, waited(i) === p.maxWait.U, credits(i) =/= 0.U, p.priority.U(4.W))
+  }
+  val winner = VecInit((0 until n).map { i =>
+    req(i) && (0 until n).filter(_ != i).map { j =>
+      !req(j) || rank(j) < rank(i) || (rank(j) === rank(i) && (j > i).B)
+    }.foldLeft(true.B)(_ && _)
+  })
+
+  // Grant of an access stalled by the slave
+  val locked = RegInit(false.B)
+  val lockGrant = Reg(Vec(n, Bool()))
+  val grant = Mux(locked, lockGrant, winner)
+
+  io.out.stb_i := req.asUInt.orR && down.io.enq.ready
+  io.out.cyc_i := io.out.stb_i
+  io.out.we_i := Mux1H(grant, io.in.map(_.we_i))
+  io.out.sel_i := Mux1H(grant, io.in.map(_.sel_i))
+  io.out.addr_i := Mux1H(grant, io.in.map(_.addr_i))
+  io.out.data_i := Mux1H(grant, io.in.map(_.data_i))
+  val issue = io.out.stb_i && !io.out.stall_o
+  locked := io.out.stb_i && io.out.stall_o
+  when (!locked) { lockGrant := winner }
+
+  down.io.enq.valid := issue
+  down.io.enq.bits := OHToUInt(grant)
+  down.io.deq.ready := io.out.ack_o
+  assert(!io.out.ack_o || down.io.deq.valid, "Wishbone ack with no access in flight")
+
+  for (i <- 0 until n) {
+    val p = ports(i)
+    val taken = issue && grant(i)
+    io.in(i).stall_o := !taken
+    io.in(i).ack_o := io.out.ack_o && down.io.deq.bits === i.U
+    io.in(i).data_o := io.out.data_o
+    io.starve(i) := req(i) && !grant(i)
+
+    // Reserved accesses, given back at the start of every window. One
+    // taken in that clock already counts against the new window
+    if (p.share > 0) {
+      val tick = RegInit(0.U(log2Up(p.window).W))
+      tick := Mux(tick === (p.window - 1).U, 0.U, tick + 1.U)
+      when (tick === 0.U) {
+        credits(i) := p.share.U - taken.asUInt
+      }.elsewhen (taken && credits(i) =/= 0.U) {
+        credits(i) := credits(i) - 1.U
+      }
+    }
+
+    when (taken || !req(i)) {
+      waited(i) := 0.U
+    }.elsewhen (waited(i) =/= p.maxWait.U) {
+      waited(i) := waited(i) + 1.U
+    }
+  }
+
+  io.idle := !down.io.deq.valid
+}
@@ -0,0 +1,138 @@
+package riscvconsole.devices.sdram
+
+import chisel3._
+import chisel3.util._
+
+// Posted write buffer between a Wishbone master and the SDRAM controller
+//
+// Writes are acked the clock after they are accepted and kept in one of
+// "entries" word entries, merging the bytes of later writes to the same
+// word under sel_i. Reads of bytes all in an entry are served from it,
+// reads of other words go to the slave ahead of the buffered writes, and
+// reads of a word partly in the buffer wait for it to be written first.
+//
+// Entries go to the slave in the row last accessed there (an open row
+// hit) whenever the bus is free, and in any row once the buffer is full,
+// a read needs them, or the master has nothing to offer. Rows are told
+// apart by bank and row as the controller decodes them (SDRAMAddrMap).
+//
+// The acks to the master stay in request order: local acks (writes and
+// forwarded reads) are only given with no read waiting for the slave.
+//
+// A request the slave stalls is held as presented until it is taken: no
+// other read goes out and no other entry is picked in the meantime.
+class WishboneWriteBuffer(entries: Int, depth: Int, sdcfg: sdram_bb_cfg) extends Module {
+  val io = IO(new Bundle {
+    val in = new Bundle with HasWishboneIf
+    val out = Flipped(new Bundle with HasWishboneIf)
+    val idle = Output(Bool()) // Nothing buffered and nothing in flight
+  })
+
+  require(entries > 0)
+  require(depth > 0)
+
+  val valid = RegInit(VecInit(Seq.fill(entries)(false.B)))
+  val addr = Reg(Vec(entries, UInt(30.W)))
+  val data = Reg(Vec(entries, Vec(4, UInt(8.W))))
+  val mask = Reg(Vec(entries, UInt(4.W)))
+
+  // Slave accesses in flight, and whether each is a read of the master
+  val down = Module(new Queue(Bool(), depth))
+  val reads = RegInit(0.U(log2Ceil(depth + 1).W))
+  def rowOf(a: UInt): UInt = {
+    val (bank, row) = SDRAMAddrMap.bankRow(sdcfg, a)
+    Cat(bank, row)
+  }
+  val lastRow = RegInit(0.U((sdcfg.SDRAM_BANK_W + sdcfg.SDRAM_ROW_W).W))
+
+  // Local ack, the clock after the request
+  val ack = RegInit(false.B)
+  val ackData = Reg(UInt(32.W))
+
+  // Request stalled by the slave: a read of the master, or entry heldIdx
+  val held = RegInit(false.B)
+  val heldRead = Reg(Bool())
+  val heldIdx = Reg(UInt(log2Up(entries).W))
+  val heldAddr = Reg(UInt(32.W))
+  val heldData = Reg(UInt(32.W))
+  val heldSel = Reg(UInt(4.W))
+
+  val req = io.in.stb_i && io.in.cyc_i
+  val word = io.in.addr_i >> 2
+  val hits = VecInit((0 until entries).map(i => valid(i) && addr(i) === word))
+  val hit = hits.asUInt.orR
+  val hitIdx = OHToUInt(hits)
+  val full = valid.asUInt.andR
+  val free = PriorityEncoder(valid.map(!_))
+  val covered = (mask(hitIdx) & io.in.sel_i) === io.in.sel_i
+  val ordered = reads === 0.U // No read of the master waiting for the slave
+
+  // Reads of the master to the slave: misses, and hits on bytes not all
+  // in the buffer once the entry is written
+  val readOut = Mux(held, heldRead, req && !io.in.we_i && !hit)
+  val readLocal = req && !io.in.we_i && hit && covered && ordered
+  val readWait = req && !io.in.we_i && hit && !covered
+
+  // Entry to write to the slave, when the bus is not taken by a read
+  val rowHits = VecInit((0 until entries).map(i => valid(i) && rowOf(addr(i) << 2) === lastRow))
+  val drainIdx = Mux(held, heldIdx,
+    Mux(readWait, hitIdx, Mux(rowHits.asUInt.orR, PriorityEncoder(rowHits), PriorityEncoder(valid))))
+  val drainWant = held || readWait || rowHits.asUInt.orR || full || (valid.asUInt.orR && !req)
+  val drain = !readOut && drainWant && down.io.enq.ready
+
+  io.out.stb_i := (readOut || drain) && down.io.enq.ready
+  io.out.cyc_i := io.out.stb_i
+  io.out.we_i := !readOut
+  io.out.addr_i := Mux(held, heldAddr, Mux(readOut, io.in.addr_i, addr(drainIdx) << 2))
+  io.out.data_i := Mux(held, heldData, Mux(readOut, io.in.data_i, data(drainIdx).asUInt))
+  io.out.sel_i := Mux(held, heldSel, Mux(readOut, io.in.sel_i, mask(drainIdx)))
+  val issue = io.out.stb_i && !io.out.stall_o
+  val drained = issue && !readOut
+
+  held := io.out.stb_i && io.out.stall_o
+  when (!held) {
+    heldRead := readOut
+    heldIdx := drainIdx
+    heldAddr := io.out.addr_i
+    heldData := io.out.data_i
+    heldSel := io.out.sel_i
+  }
+
+  // Writes of the master, merged into their entry or to a free one. Not
+  // into an entry on its way to the slave
+  val mergeOk = hit && !(drain && drainIdx === hitIdx)
+  val writeLocal = req && io.in.we_i && ordered && (mergeOk || (!hit && !full))
+
+  io.in.stall_o := Mux(readOut, !down.io.enq.ready || io.out.stall_o, !(readLocal || writeLocal))
+
+  when (drained) { valid(drainIdx) := false.B }
+  when (writeLocal) {
+    val idx = Mux(hit, hitIdx, free)
+    valid(idx) := true.B
+    addr(idx) := word
+    mask(idx) := Mux(hit, mask(idx), 0.U) | io.in.sel_i
+    for (b <- 0 until 4) {
+      when (io.in.sel_i(b)) { data(idx)(b) := io.in.data_i(8 * b + 7, 8 * b) }
+    }
+  }
+
+  // Forwarded read: buffered bytes, the rest of the word is not asked for
+  val fwd = VecInit((0 until 4).map(b => Mux(mask(hitIdx)(b), data(hitIdx)(b), 0.U))).asUInt
+  ack := readLocal || writeLocal
+  ackData := fwd
+
+  when (issue) { lastRow := rowOf(io.out.addr_i) }
+
+  down.io.enq.valid := issue
+  down.io.enq.bits := readOut
+  down.io.deq.ready := io.out.ack_o
+  assert(!io.out.ack_o || down.io.deq.valid, "Wishbone ack with no access in flight")
+  reads := reads + (issue && readOut).asUInt - (io.out.ack_o && down.io.deq.bits).asUInt
+
+  val readAck = io.out.ack_o && down.io.deq.bits
+  assert(!(ack && readAck), "Local and slave acks in the same clock")
+  io.in.ack_o := ack || readAck
+  io.in.data_o := Mux(ack, ackData, io.out.data_o)
+
+  io.idle := !valid.asUInt.orR && !down.io.deq.valid && !ack && !held
+}
@@ -0,0 +1,146 @@
+package riscvconsole.devices.sdram
+
+import chisel3._
+import chisel3.util._
+
+// One clock pulses, for performance counters
+class WishbonePrefetchEvents(val entries: Int) extends Bundle {
+  val hit = Bool() // Read served from the buffer
+  val miss = Bool() // Read sent to the slave
+  val issue = Bool() // Prefetch read sent to the slave
+  val drop = UInt(log2Up(entries + 1).W) // Prefetched words thrown away unread
+}
+
+// Slave access in flight: the master's, or a prefetch into entry idx
+class WishbonePrefetchTag(val entries: Int) extends Bundle {
+  val prefetch = Bool()
+  val idx = UInt(log2Up(entries).W)
+}
+
+// Stream prefetch buffer between a Wishbone master and the SDRAM controller
+//
+// A read that misses at the word after the previous read starts a stream:
+// the words that follow it are read into the "entries" words of the
+// buffer, one each time the master leaves the bus free, and later reads of
+// them are acked the next clock. A word leaves the buffer once read, which
+// makes room for the next one of the stream, so a stream that stops being
+// read costs at most "entries" reads. A new stream throws the old one away.
+//
+// Writes go to the slave and throw away the word they write, if buffered
+// or on its way. Reads of a word on its way wait for it. The acks to the
+// master stay in request order: buffer hits are only acked with no access
+// of the master waiting for the slave.
+//
+// A prefetch the slave stalls stays on the bus until it is taken, and the
+// accesses of the master wait behind it.
+class WishbonePrefetch(entries: Int, depth: Int) extends Module {
+  val io = IO(new Bundle {
+    val in = new Bundle with HasWishboneIf
+    val out = Flipped(new Bundle with HasWishboneIf)
+    val idle = Output(Bool()) // Nothing in flight
+    val events = Output(new WishbonePrefetchEvents(entries))
+  })
+
+  require(entries > 0)
+  require(depth > 0)
+
+  val busy = RegInit(VecInit(Seq.fill(entries)(false.B))) // Allocated to a word
+  val ready = Reg(Vec(entries, Bool())) // Data arrived
+  val drop = Reg(Vec(entries, Bool())) // Thrown away on its way
+  val addr = Reg(Vec(entries, UInt(30.W)))
+  val data = Reg(Vec(entries, UInt(32.W)))
+
+  // Slave accesses in flight: the master's, or a prefetch into an entry
+  val down = Module(new Queue(new WishbonePrefetchTag(entries), depth))
+  val pending = RegInit(0.U(log2Ceil(depth + 1).W)) // The master's
+
+  val active = RegInit(false.B)
+  val next = Reg(UInt(30.W)) // Next word of the stream to prefetch
+  val last = RegInit(0.U(30.W)) // Word of the last read
+
+  // Local ack, the clock after the request
+  val ack = RegInit(false.B)
+  val ackData = Reg(UInt(32.W))
+
+  // Prefetch stalled by the slave. Its address, next, only moves once it
+  // is taken
+  val offered = RegInit(false.B)
+
+  val req = io.in.stb_i && io.in.cyc_i
+  val word = io.in.addr_i >> 2
+  val found = VecInit((0 until entries).map(i => busy(i) && !drop(i) && addr(i) === word))
+  val hit = found.asUInt.orR
+  val hitIdx = OHToUInt(found)
+  val hitReady = hit && ready(hitIdx)
+
+  val readLocal = req && !io.in.we_i && hitReady && pending === 0.U
+  val through = req && (io.in.we_i || !hit) && !offered
+  val free = busy.map(!_)
+  val prefetch = offered || (!through && active && free.reduce(_ || _))
+
+  io.out.stb_i := (through || prefetch) && down.io.enq.ready
+  io.out.cyc_i := io.out.stb_i
+  io.out.we_i := through && io.in.we_i
+  io.out.addr_i := Mux(through, io.in.addr_i, next << 2)
+  io.out.data_i := io.in.data_i
+  io.out.sel_i := Mux(through, io.in.sel_i, "b1111".U)
+  val issue = io.out.stb_i && !io.out.stall_o
+  val freeIdx = PriorityEncoder(free)
+  offered := io.out.stb_i && io.out.stall_o && prefetch
+
+  io.in.stall_o := Mux(through, !down.io.enq.ready || io.out.stall_o, !readLocal)
+
+  down.io.enq.valid := issue
+  down.io.enq.bits.prefetch := !through
+  down.io.enq.bits.idx := freeIdx
+  down.io.deq.ready := io.out.ack_o
+  assert(!io.out.ack_o || down.io.deq.valid, "Wishbone ack with no access in flight")
+
+  val fill = io.out.ack_o && down.io.deq.bits.prefetch
+  val fillIdx = down.io.deq.bits.idx
+  pending := pending + (issue && through).asUInt - (io.out.ack_o && !fill).asUInt
+
+  // Start a stream on a sequential miss, unless the stream is already
+  // past it. Throw away the entries of the old one
+  val restart = issue && through && !io.in.we_i && word === last + 1.U && !(active && next > word)
+  when (req && !io.in.we_i && !io.in.stall_o) { last := word }
+
+  val kill = VecInit((0 until entries).map(i => busy(i) && (restart || (issue && through && io.in.we_i && found(i)))))
+  for (i <- 0 until entries) {
+    when (kill(i)) {
+      when (ready(i)) { busy(i) := false.B }.otherwise { drop(i) := true.B }
+    }
+    when (fill && fillIdx === i.U) {
+      when (drop(i) || kill(i)) { busy(i) := false.B }.otherwise { ready(i) := true.B }
+      data(i) := io.out.data_o
+    }
+    when (readLocal && hitIdx === i.U) { busy(i) := false.B }
+    when (issue && prefetch && freeIdx === i.U) {
+      busy(i) := true.B
+      ready(i) := false.B
+      drop(i) := false.B
+      addr(i) := next
+    }
+  }
+  when (restart) {
+    active := true.B
+    next := word + 1.U
+  }.elsewhen (issue && prefetch) {
+    next := next + 1.U
+  }
+
+  ack := readLocal
+  ackData := data(hitIdx)
+
+  val fwdAck = io.out.ack_o && !fill
+  assert(!(ack && fwdAck), "Local and slave acks in the same clock")
+  io.in.ack_o := ack || fwdAck
+  io.in.data_o := Mux(ack, ackData, io.out.data_o)
+
+  io.idle := !down.io.deq.valid && !ack && !io.out.stb_i
+
+  io.events.hit := readLocal
+  io.events.miss := issue && through && !io.in.we_i
+  io.events.issue := issue && prefetch
+  io.events.drop := PopCount((0 until entries).map(i => kill(i) && !drop(i)))
+}
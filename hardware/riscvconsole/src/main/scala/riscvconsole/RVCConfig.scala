@@ -3,6 +3,7 @@ package riscvconsole.system
 import chipsalliance.rocketchip.config._
 import freechips.rocketchip.subsystem._
 import freechips.rocketchip.devices.debug._
+import freechips.rocketchip.diplomacy.{ClockCrossingType, SynchronousCrossing}
 import freechips.rocketchip.devices.tilelink.MaskROMLocated
 import riscvconsole.devices.altera.ddr3.QsysDDR3Mem
 import riscvconsole.devices.codec._
@@ -40,6 +41,40 @@ class WithSDRAM(cfg: SDRAMConfig) extends Config((site, here, up) => {
   case SDRAMKey => Seq(cfg)
 })
 
+// Simulation only: the SDRAM controller and model skip the 100uS power up wait
+class WithSDRAMFastInit extends Config((site, here, up) => {
+  case SDRAMKey => up(SDRAMKey).map{sd => sd.copy(sdcfg = sd.sdcfg.copy(SDRAM_FAST_INIT = true))}
+})
+
+// SDRAM address mapping (SDRAMAddrMap), for comparing them with the
+// simulation model (sdram_capture + sims/sdram/sdrammap)
+class WithSDRAMAddrMap(map: Int) extends Config((site, here, up) => {
+  case SDRAMKey => up(SDRAMKey).map{sd => sd.copy(sdcfg = sd.sdcfg.copy(SDRAM_ADDR_MAP = map))}
+})
+
+// SDRAM arbitration: the MBUS port, then DMA ports for masters to connect
+// to (SDRAM.dmaXing)
+class WithSDRAMPorts(ports: Seq[SDRAMPortParams]) extends Config((site, here, up) => {
+  case SDRAMKey => up(SDRAMKey).map{sd => sd.copy(ports = ports)}
+})
+
+// SDRAM Wishbone pipeline: accesses in flight, posted write entries and
+// prefetched words (SDRAMConfig), off by default
+class WithSDRAMPipeline(maxInFlight: Int = 8, writeBuffer: Int = 4, prefetch: Int = 16) extends Config((site, here, up) => {
+  case SDRAMKey => up(SDRAMKey).map{sd => sd.copy(maxInFlight = maxInFlight, writeBuffer = writeBuffer, prefetch = prefetch)}
+})
+
+// SDRAM clock crossing from the MBUS (SDRAMConfig.crossing)
+class WithSDRAMCrossing(crossing: ClockCrossingType) extends Config((site, here, up) => {
+  case SDRAMKey => up(SDRAMKey).map{sd => sd.copy(crossing = crossing)}
+})
+
+// Simulation only: the SDRAM TL ports can be served without the controller
+// (+sdram_functional[=<clock>] on the simulator command line)
+class WithSDRAMFunctional extends Config((site, here, up) => {
+  case SDRAMKey => up(SDRAMKey).map{sd => sd.copy(simFunctional = true)}
+})
+
 class WithSRAM(cfg: SRAMConfig) extends Config((site, here, up) => {
   case SRAMKey => Seq(cfg)
 })
@@ -101,6 +136,8 @@ class ArrowConfig extends Config(
 class DE2Config extends Config(
   new WithSDRAM(SDRAMConfig(
     address = 0x80000000L,
+    perfAddress = Some(0x10007000L),
+    crossing = SynchronousCrossing(), // otherclock is the system clock
     sdcfg = sdram_bb_cfg(
       SDRAM_HZ = 50000000L,
       SDRAM_DQM_W = 4,
@@ -166,3 +203,5 @@ class Nexys4DDRConfig extends Config(
     new freechips.rocketchip.system.BaseConfig)                    // "base" rocketchip system
 
 class RVCHarnessConfig extends Config(new SetFrequency(100000000) ++ new DE2Config)
+class RVCHarnessFastConfig extends Config(new WithSDRAMFastInit ++ new RVCHarnessConfig)
+class RVCHarnessFunctionalConfig extends Config(new WithSDRAMFunctional ++ new RVCHarnessFastConfig)
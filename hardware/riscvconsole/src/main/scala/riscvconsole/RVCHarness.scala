@@ -88,7 +88,7 @@ class RVCHarness()(implicit p: Parameters) extends Module {
   dut.spi.foreach(_.dq.foreach(_.i := false.B)) // Tie down for now
 
   // SDRAM
-  dut.sdramio.foreach(sdramsim(_, reset.asBool()))
+  (dut.sdramio zip p(SDRAMKey)).foreach { case (io, cfg) => sdramsim(io, reset.asBool(), cfg.address) }
   dut.otherclock := clock
 
   // I2C
@@ -104,6 +104,8 @@ class RVCSystemModuleImp[+L <: RVCSystem](_outer: L) extends RVCSubsystemModuleI
   println(s"Connecting clocks...")
   val extclocks = outer.clockGroup.out.flatMap(_._1.member.elements)
   val namedclocks = outer.clocksAggregator.out.flatMap(_._1.member.elements)
+  // Clock of the SDRAM with a rational or asynchronous crossing. Unused
+  // when SDRAMConfig.crossing is synchronous: the SDRAM runs on the MBUS clock
   val otherclock = IO(Input(Clock()))
   (extclocks zip namedclocks).foreach{ case ((_, o), (name, _)) =>
     println(s"  Connecting ${name}")
@@ -114,4 +116,6 @@ class RVCSystemModuleImp[+L <: RVCSystem](_outer: L) extends RVCSubsystemModuleI
       o.clock := otherclock
     }
   }
+  if(!namedclocks.exists(_._1.contains("sdramClockGroup")))
+    println("  otherclock not used")
 }
\ No newline at end of file
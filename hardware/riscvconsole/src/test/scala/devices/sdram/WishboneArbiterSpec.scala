@@ -0,0 +1,184 @@
+package riscvconsole.devices.sdram
+
+import chisel3.iotesters.{ChiselFlatSpec, Driver, PeekPokeTester}
+
+// Requests of the ports and checks of the grant. The slave starts out
+// taking everything and acking nothing
+abstract class WishboneArbiterTester(c: WishboneArbiter) extends PeekPokeTester(c) {
+  def request(port: Int, addr: BigInt): Unit = {
+    poke(c.io.in(port).stb_i, 1)
+    poke(c.io.in(port).cyc_i, 1)
+    poke(c.io.in(port).we_i, 0)
+    poke(c.io.in(port).addr_i, addr)
+    poke(c.io.in(port).data_i, 0)
+    poke(c.io.in(port).sel_i, 0xf)
+  }
+  def noRequest(port: Int): Unit = {
+    poke(c.io.in(port).stb_i, 0)
+    poke(c.io.in(port).cyc_i, 0)
+  }
+  // Port taking the bus this clock, of two both requesting, port p at
+  // 0x1000 * (p + 1)
+  def expectGrant(port: Int): Unit = {
+    expect(c.io.out.stb_i, 1)
+    expect(c.io.out.addr_i, 0x1000 * (port + 1))
+    expect(c.io.in(port).stall_o, 0)
+    expect(c.io.in(1 - port).stall_o, 1)
+    expect(c.io.starve(port), 0)
+    expect(c.io.starve(1 - port), 1)
+  }
+
+  poke(c.io.out.stall_o, 0)
+  poke(c.io.out.ack_o, 0)
+  poke(c.io.out.data_o, 0)
+}
+
+// Port 0 is granted and the slave stalls its access, then port 1, of a
+// higher priority, asks too: port 0 keeps the bus until its access is
+// taken, and only then does port 1 win.
+class WishboneArbiterStallTester(c: WishboneArbiter) extends WishboneArbiterTester(c) {
+  poke(c.io.out.stall_o, 1)
+  noRequest(1)
+
+  request(0, 0x100)
+  expect(c.io.out.stb_i, 1)
+  expect(c.io.out.addr_i, 0x100)
+  step(1)
+
+  request(1, 0x2000)
+  for (_ <- 0 until 3) {
+    expect(c.io.out.stb_i, 1)
+    expect(c.io.out.addr_i, 0x100)
+    expect(c.io.in(0).stall_o, 1)
+    expect(c.io.in(1).stall_o, 1)
+    expect(c.io.starve(1), 1)
+    step(1)
+  }
+
+  poke(c.io.out.stall_o, 0)
+  expect(c.io.out.addr_i, 0x100)
+  expect(c.io.in(0).stall_o, 0)
+  expect(c.io.in(1).stall_o, 1)
+  step(1)
+
+  noRequest(0)
+  expect(c.io.out.stb_i, 1)
+  expect(c.io.out.addr_i, 0x2000)
+  expect(c.io.in(1).stall_o, 0)
+  step(1)
+
+  // Acks in request order
+  noRequest(1)
+  poke(c.io.out.ack_o, 1)
+  expect(c.io.in(0).ack_o, 1)
+  expect(c.io.in(1).ack_o, 0)
+  step(1)
+  expect(c.io.in(0).ack_o, 0)
+  expect(c.io.in(1).ack_o, 1)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.idle, 1)
+}
+
+// Port 1, real time at the lowest priority, wins every clock over port 0
+// at the highest, which starves. Alone, port 0 is granted and no port
+// starves
+class WishboneArbiterRealtimeTester(c: WishboneArbiter) extends WishboneArbiterTester(c) {
+  request(0, 0x1000)
+  request(1, 0x2000)
+  expectGrant(1)
+  step(1)
+  poke(c.io.out.ack_o, 1)
+  for (_ <- 0 until 4) {
+    expectGrant(1)
+    expect(c.io.in(1).ack_o, 1)
+    step(1)
+  }
+
+  noRequest(1)
+  expect(c.io.out.addr_i, 0x1000)
+  expect(c.io.in(0).stall_o, 0)
+  expect(c.io.starve(0), 0)
+  expect(c.io.starve(1), 0)
+  step(1)
+  noRequest(0)
+  expect(c.io.in(0).ack_o, 1)
+  expect(c.io.starve(0), 0)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.idle, 1)
+}
+
+// Port 0, at a lower priority than port 1, waits maxWait = 4 clocks and
+// then wins over it for one access, every fifth clock
+class WishboneArbiterMaxWaitTester(c: WishboneArbiter) extends WishboneArbiterTester(c) {
+  request(0, 0x1000)
+  request(1, 0x2000)
+  for (_ <- 0 until 3) {
+    for (_ <- 0 until 4) {
+      expectGrant(1)
+      step(1)
+      poke(c.io.out.ack_o, 1)
+    }
+    expectGrant(0)
+    step(1)
+  }
+}
+
+// Port 0 has a share of 2 accesses every 8 clocks over port 1, of a
+// higher priority but no share. It takes them at once in the first
+// window, and in the next ones from the clock after they are given back;
+// port 1 gets the rest of the clocks
+class WishboneArbiterShareTester(c: WishboneArbiter) extends WishboneArbiterTester(c) {
+  request(0, 0x1000)
+  request(1, 0x2000)
+  for (t <- 0 until 8) {
+    if (t < 2) {
+      expectGrant(0)
+    } else {
+      expectGrant(1)
+    }
+    step(1)
+    poke(c.io.out.ack_o, 1)
+  }
+  for (_ <- 0 until 3) {
+    for (t <- 0 until 8) {
+      if (t == 1 || t == 2) {
+        expectGrant(0)
+      } else {
+        expectGrant(1)
+      }
+      step(1)
+    }
+  }
+}
+
+class WishboneArbiterSpec extends ChiselFlatSpec {
+  "WishboneArbiter" should "keep the grant of a stalled access" in {
+    val ports = Seq(SDRAMPortParams(priority = 0), SDRAMPortParams(priority = 5))
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneArbiter(ports, 2)) {
+      c => new WishboneArbiterStallTester(c)
+    } should be (true)
+  }
+
+  "WishboneArbiter" should "grant a real time port over a higher priority" in {
+    val ports = Seq(SDRAMPortParams(priority = 15), SDRAMPortParams(priority = 0, realtime = true))
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneArbiter(ports, 2)) {
+      c => new WishboneArbiterRealtimeTester(c)
+    } should be (true)
+  }
+
+  "WishboneArbiter" should "grant a port that waited maxWait clocks" in {
+    val ports = Seq(SDRAMPortParams(priority = 0, maxWait = 4), SDRAMPortParams(priority = 5))
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneArbiter(ports, 2)) {
+      c => new WishboneArbiterMaxWaitTester(c)
+    } should be (true)
+  }
+
+  "WishboneArbiter" should "give a port its share of every window" in {
+    val ports = Seq(SDRAMPortParams(priority = 0, share = 2, window = 8), SDRAMPortParams(priority = 5))
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneArbiter(ports, 2)) {
+      c => new WishboneArbiterShareTester(c)
+    } should be (true)
+  }
+}
@@ -0,0 +1,276 @@
+package riscvconsole.devices.sdram
+
+import chisel3.iotesters.{ChiselFlatSpec, Driver, PeekPokeTester}
+
+// Requests of the master and checks of the slave side, for a buffer of
+// two entries. The slave starts out taking everything and acking nothing
+abstract class WishbonePrefetchTester(c: WishbonePrefetch) extends PeekPokeTester(c) {
+  def request(we: Boolean, addr: BigInt, data: BigInt): Unit = {
+    poke(c.io.in.stb_i, 1)
+    poke(c.io.in.cyc_i, 1)
+    poke(c.io.in.we_i, we)
+    poke(c.io.in.addr_i, addr)
+    poke(c.io.in.data_i, data)
+    poke(c.io.in.sel_i, 0xf)
+  }
+  def noRequest(): Unit = {
+    poke(c.io.in.stb_i, 0)
+    poke(c.io.in.cyc_i, 0)
+  }
+  def expectOut(we: Boolean, addr: BigInt): Unit = {
+    expect(c.io.out.stb_i, 1)
+    expect(c.io.out.we_i, we)
+    expect(c.io.out.addr_i, addr)
+  }
+  def slaveAck(data: BigInt): Unit = {
+    poke(c.io.out.ack_o, 1)
+    poke(c.io.out.data_o, data)
+  }
+  // Reads of addr - 4 and addr, each acked the clock after. A stream
+  // starts after addr: on return addr + 4 is on its way to entry 0, and
+  // addr + 8 is on the bus
+  def startStream(addr: BigInt): Unit = {
+    for (i <- 0 until 2) {
+      request(false, addr - 4 + 4 * i, 0)
+      step(1)
+      noRequest()
+      slaveAck(0)
+      step(1)
+      poke(c.io.out.ack_o, 0)
+    }
+    expectOut(false, addr + 8)
+  }
+
+  poke(c.io.out.stall_o, 0)
+  poke(c.io.out.ack_o, 0)
+  poke(c.io.out.data_o, 0)
+}
+
+// A read of the word after the previous one starts a stream, prefetched
+// while the bus is free. A new stream throws the old one away: the word
+// buffered and the one still on its way, which is not kept when it comes
+class WishbonePrefetchRestartTester(c: WishbonePrefetch) extends WishbonePrefetchTester(c) {
+  request(false, 0x100, 0)
+  expectOut(false, 0x100)
+  expect(c.io.events.miss, 1)
+  step(1)
+  noRequest()
+  slaveAck(0x0a)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x0a)
+  expect(c.io.out.stb_i, 0)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  request(false, 0x104, 0)
+  expectOut(false, 0x104)
+  step(1)
+
+  noRequest()
+  slaveAck(0x0b)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x0b)
+  expectOut(false, 0x108)
+  expect(c.io.events.issue, 1)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expectOut(false, 0x10c)
+  expect(c.io.events.issue, 1)
+  step(1)
+  // Full: 0x108 arrives, 0x10c is on its way
+  expect(c.io.out.stb_i, 0)
+  slaveAck(0x0c)
+  expect(c.io.in.ack_o, 0)
+  step(1)
+
+  poke(c.io.out.ack_o, 0)
+  request(false, 0x2000, 0)
+  expectOut(false, 0x2000)
+  expect(c.io.events.drop, 0)
+  step(1)
+  request(false, 0x2004, 0)
+  expectOut(false, 0x2004)
+  expect(c.io.events.drop, 2)
+  step(1)
+
+  // 0x10c arrives and is thrown away; the new stream takes the entries
+  noRequest()
+  slaveAck(0x0d)
+  expect(c.io.in.ack_o, 0)
+  expectOut(false, 0x2008)
+  step(1)
+  slaveAck(0x0e)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x0e)
+  expectOut(false, 0x200c)
+  step(1)
+  slaveAck(0x0f)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x0f)
+  expect(c.io.out.stb_i, 0)
+  step(1)
+  slaveAck(0x11)
+  expect(c.io.in.ack_o, 0)
+  step(1)
+  slaveAck(0x12)
+  expect(c.io.in.ack_o, 0)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+
+  // The new stream is read from the buffer, the old one from the slave
+  request(false, 0x2008, 0)
+  expect(c.io.in.stall_o, 0)
+  expect(c.io.events.hit, 1)
+  expect(c.io.out.stb_i, 0)
+  step(1)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x11)
+  for (i <- 0 until 2) {
+    request(false, 0x108 + 4 * i, 0)
+    expectOut(false, 0x108 + 4 * i)
+    expect(c.io.events.miss, 1)
+    expect(c.io.in.stall_o, 0)
+    step(1)
+  }
+}
+
+// Writes go to the slave, throwing away the word they write: buffered,
+// and on its way, which is not kept when it comes. Reads of both words go
+// to the slave, one while the word thrown away is still on its way
+class WishbonePrefetchWriteTester(c: WishbonePrefetch) extends WishbonePrefetchTester(c) {
+  startStream(0x104)
+  step(1)
+  slaveAck(0x0c)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+
+  request(true, 0x108, 0x55)
+  expectOut(true, 0x108)
+  expect(c.io.out.data_i, 0x55)
+  expect(c.io.events.drop, 1)
+  step(1)
+  request(true, 0x10c, 0x66)
+  expectOut(true, 0x10c)
+  expect(c.io.events.drop, 1)
+  step(1)
+  request(false, 0x10c, 0)
+  expectOut(false, 0x10c)
+  expect(c.io.in.stall_o, 0)
+  expect(c.io.events.miss, 1)
+  step(1)
+
+  // 0x10c arrives and is thrown away, then the writes and the read are
+  // acked
+  noRequest()
+  slaveAck(0x0d)
+  expect(c.io.in.ack_o, 0)
+  step(1)
+  for (_ <- 0 until 2) {
+    expect(c.io.in.ack_o, 1)
+    step(1)
+  }
+  slaveAck(0x66)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x66)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+
+  request(false, 0x108, 0)
+  expectOut(false, 0x108)
+  expect(c.io.events.hit, 0)
+  expect(c.io.events.miss, 1)
+  step(1)
+  noRequest()
+}
+
+// A prefetch the slave stalls stays on the bus as it was, with a read of
+// the master that arrives meanwhile stalled behind it, until it is taken
+class WishbonePrefetchStallTester(c: WishbonePrefetch) extends WishbonePrefetchTester(c) {
+  startStream(0x104)
+  poke(c.io.out.stall_o, 1)
+  expect(c.io.events.issue, 0)
+  step(1)
+  request(false, 0x2000, 0)
+  for (_ <- 0 until 3) {
+    expectOut(false, 0x10c)
+    expect(c.io.out.sel_i, 0xf)
+    expect(c.io.in.stall_o, 1)
+    expect(c.io.events.issue, 0)
+    step(1)
+  }
+  poke(c.io.out.stall_o, 0)
+  expectOut(false, 0x10c)
+  expect(c.io.in.stall_o, 1)
+  expect(c.io.events.issue, 1)
+  step(1)
+  expectOut(false, 0x2000)
+  expect(c.io.in.stall_o, 0)
+  expect(c.io.events.miss, 1)
+  step(1)
+  noRequest()
+}
+
+// A read of a buffered word waits while a read of the master is on its way
+// to the slave, so the acks stay in request order
+class WishbonePrefetchOrderTester(c: WishbonePrefetch) extends WishbonePrefetchTester(c) {
+  startStream(0x104)
+  step(1)
+  slaveAck(0x0c)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+
+  request(false, 0x2000, 0)
+  expectOut(false, 0x2000)
+  step(1)
+  request(false, 0x108, 0)
+  for (_ <- 0 until 2) {
+    expect(c.io.in.stall_o, 1)
+    expect(c.io.in.ack_o, 0)
+    expect(c.io.events.hit, 0)
+    expect(c.io.out.stb_i, 0)
+    step(1)
+  }
+
+  // 0x10c arrives, then the read of the master
+  slaveAck(0x0d)
+  expect(c.io.in.ack_o, 0)
+  expect(c.io.in.stall_o, 1)
+  step(1)
+  slaveAck(0x55)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x55)
+  expect(c.io.in.stall_o, 1)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.in.stall_o, 0)
+  expect(c.io.events.hit, 1)
+  step(1)
+  noRequest()
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x0c)
+}
+
+class WishbonePrefetchSpec extends ChiselFlatSpec {
+  "WishbonePrefetch" should "restart a stream and throw the old one away" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishbonePrefetch(2, 4)) {
+      c => new WishbonePrefetchRestartTester(c)
+    } should be (true)
+  }
+
+  "WishbonePrefetch" should "throw away the words the master writes" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishbonePrefetch(2, 4)) {
+      c => new WishbonePrefetchWriteTester(c)
+    } should be (true)
+  }
+
+  "WishbonePrefetch" should "hold a stalled prefetch while a read arrives" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishbonePrefetch(2, 4)) {
+      c => new WishbonePrefetchStallTester(c)
+    } should be (true)
+  }
+
+  "WishbonePrefetch" should "keep buffer hits behind reads in flight" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishbonePrefetch(2, 4)) {
+      c => new WishbonePrefetchOrderTester(c)
+    } should be (true)
+  }
+}
@@ -0,0 +1,263 @@
+package riscvconsole.devices.sdram
+
+import chisel3.iotesters.{ChiselFlatSpec, Driver, PeekPokeTester}
+
+// Requests of the master and checks of the slave side. The slave starts
+// out taking everything and acking nothing
+abstract class WishboneWriteBufferTester(c: WishboneWriteBuffer) extends PeekPokeTester(c) {
+  def request(we: Boolean, addr: BigInt, data: BigInt, sel: Int = 0xf): Unit = {
+    poke(c.io.in.stb_i, 1)
+    poke(c.io.in.cyc_i, 1)
+    poke(c.io.in.we_i, we)
+    poke(c.io.in.addr_i, addr)
+    poke(c.io.in.data_i, data)
+    poke(c.io.in.sel_i, sel)
+  }
+  def noRequest(): Unit = {
+    poke(c.io.in.stb_i, 0)
+    poke(c.io.in.cyc_i, 0)
+  }
+  def expectOut(we: Boolean, addr: BigInt, data: BigInt, sel: Int = 0xf): Unit = {
+    expect(c.io.out.stb_i, 1)
+    expect(c.io.out.we_i, we)
+    expect(c.io.out.addr_i, addr)
+    if (we) {
+      expect(c.io.out.data_i, data)
+      expect(c.io.out.sel_i, sel)
+    }
+  }
+
+  poke(c.io.out.stall_o, 0)
+  poke(c.io.out.ack_o, 0)
+  poke(c.io.out.data_o, 0)
+}
+
+// A buffered write goes out and the slave stalls it, then a read of
+// another word shows up: the write stays on the bus as it was until it is
+// taken, and only then does the read go out.
+class WishboneWriteBufferStallTester(c: WishboneWriteBuffer) extends WishboneWriteBufferTester(c) {
+  poke(c.io.out.stall_o, 1)
+
+  request(true, 0x100, 0x11223344)
+  expect(c.io.in.stall_o, 0)
+  step(1)
+  expect(c.io.in.ack_o, 1)
+
+  // Bus free: the entry goes out, and is stalled
+  noRequest()
+  expectOut(true, 0x100, 0x11223344)
+  step(1)
+
+  request(false, 0x2000, 0)
+  for (_ <- 0 until 3) {
+    expectOut(true, 0x100, 0x11223344)
+    expect(c.io.in.stall_o, 1)
+    step(1)
+  }
+
+  poke(c.io.out.stall_o, 0)
+  expectOut(true, 0x100, 0x11223344)
+  expect(c.io.in.stall_o, 1)
+  step(1)
+
+  expectOut(false, 0x2000, 0)
+  expect(c.io.in.stall_o, 0)
+  step(1)
+  noRequest()
+  poke(c.io.out.ack_o, 1)
+  poke(c.io.out.data_o, 0x55667788)
+  expect(c.io.in.ack_o, 0)
+  step(1)
+  poke(c.io.out.ack_o, 1)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x55667788)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.idle, 1)
+}
+
+// Two writes of the halves of a word, back to back: the second merges
+// into the entry of the first, and the word goes out once, whole. The
+// word is out of the open row, so nothing goes out while the master is on
+// the bus.
+class WishboneWriteBufferMergeTester(c: WishboneWriteBuffer) extends WishboneWriteBufferTester(c) {
+  request(true, 0x10000, 0x1122, 0x3)
+  expect(c.io.in.stall_o, 0)
+  step(1)
+  request(true, 0x10000, 0x33440000, 0xc)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.stall_o, 0)
+  expect(c.io.out.stb_i, 0)
+  step(1)
+  noRequest()
+  expect(c.io.in.ack_o, 1)
+  expectOut(true, 0x10000, 0x33441122, 0xf)
+  step(1)
+  expect(c.io.in.ack_o, 0)
+  expect(c.io.out.stb_i, 0)
+  poke(c.io.out.ack_o, 1)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.idle, 1)
+}
+
+// A read of bytes all in an entry is acked from it the next clock, with
+// nothing sent to the slave
+class WishboneWriteBufferForwardTester(c: WishboneWriteBuffer) extends WishboneWriteBufferTester(c) {
+  request(true, 0x10000, 0x4afef00d)
+  step(1)
+  request(false, 0x10000, 0, 0x3)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.stall_o, 0)
+  expect(c.io.out.stb_i, 0)
+  step(1)
+  noRequest()
+  poke(c.io.out.data_o, 0x12345678)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x4afef00d)
+  // Then the entry drains
+  expectOut(true, 0x10000, 0x4afef00d)
+}
+
+// A read of a word only partly in the buffer waits while its entry goes
+// out, then goes to the slave behind it. Its data comes from the slave,
+// after the ack of the write
+class WishboneWriteBufferReadWaitTester(c: WishboneWriteBuffer) extends WishboneWriteBufferTester(c) {
+  request(true, 0x10000, 0x1122, 0x3)
+  step(1)
+  request(false, 0x10000, 0)
+  expect(c.io.in.stall_o, 1)
+  expect(c.io.out.stb_i, 1)
+  expect(c.io.out.we_i, 1)
+  expect(c.io.out.addr_i, 0x10000)
+  expect(c.io.out.sel_i, 0x3)
+  step(1)
+  expect(c.io.in.ack_o, 0)
+  expectOut(false, 0x10000, 0)
+  expect(c.io.in.stall_o, 0)
+  step(1)
+  noRequest()
+  expect(c.io.out.stb_i, 0)
+  poke(c.io.out.ack_o, 1)
+  poke(c.io.out.data_o, 0x33441122)
+  expect(c.io.in.ack_o, 0)
+  step(1)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x33441122)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.idle, 1)
+}
+
+// Writes out of the open row fill the buffer while the master keeps the
+// bus. The next write is stalled while the first entry goes out, and then
+// takes its place; the others are in the open row now and follow it, in
+// entry order
+class WishboneWriteBufferFullTester(c: WishboneWriteBuffer) extends WishboneWriteBufferTester(c) {
+  for (i <- 0 until 4) {
+    request(true, 0x10000 + 4 * i, 0x100 + i)
+    expect(c.io.in.stall_o, 0)
+    expect(c.io.out.stb_i, 0)
+    step(1)
+  }
+  request(true, 0x10010, 0x104)
+  expect(c.io.in.stall_o, 1)
+  expectOut(true, 0x10000, 0x100)
+  step(1)
+  // The slave acks every write the clock after taking it
+  poke(c.io.out.ack_o, 1)
+  expect(c.io.in.stall_o, 0)
+  expectOut(true, 0x10004, 0x101)
+  step(1)
+  noRequest()
+  expect(c.io.in.ack_o, 1)
+  expectOut(true, 0x10010, 0x104)
+  step(1)
+  expectOut(true, 0x10008, 0x102)
+  step(1)
+  expectOut(true, 0x1000c, 0x103)
+  step(1)
+  expect(c.io.out.stb_i, 0)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.idle, 1)
+}
+
+// A read goes to the slave while a write is buffered. Until its ack, a
+// read of the buffered word and another write are stalled, not acked
+// locally ahead of it
+class WishboneWriteBufferOrderTester(c: WishboneWriteBuffer) extends WishboneWriteBufferTester(c) {
+  request(true, 0x10000, 0x11223344)
+  step(1)
+  request(false, 0x20000, 0)
+  expect(c.io.in.ack_o, 1)
+  expectOut(false, 0x20000, 0)
+  expect(c.io.in.stall_o, 0)
+  step(1)
+
+  request(false, 0x10000, 0)
+  for (_ <- 0 until 2) {
+    expect(c.io.in.ack_o, 0)
+    expect(c.io.in.stall_o, 1)
+    expect(c.io.out.stb_i, 0)
+    step(1)
+  }
+  request(true, 0x10004, 0x55667788)
+  expect(c.io.in.ack_o, 0)
+  expect(c.io.in.stall_o, 1)
+  step(1)
+
+  // The slave acks the read, then the buffered word is read locally
+  request(false, 0x10000, 0)
+  poke(c.io.out.ack_o, 1)
+  poke(c.io.out.data_o, 0x0a0b0c0d)
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x0a0b0c0d)
+  expect(c.io.in.stall_o, 1)
+  step(1)
+  poke(c.io.out.ack_o, 0)
+  expect(c.io.in.ack_o, 0)
+  expect(c.io.in.stall_o, 0)
+  step(1)
+  noRequest()
+  expect(c.io.in.ack_o, 1)
+  expect(c.io.in.data_o, 0x11223344)
+}
+
+class WishboneWriteBufferSpec extends ChiselFlatSpec {
+  "WishboneWriteBuffer" should "hold a stalled drain while a read arrives" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneWriteBuffer(4, 2, sdram_bb_cfg())) {
+      c => new WishboneWriteBufferStallTester(c)
+    } should be (true)
+  }
+
+  "WishboneWriteBuffer" should "merge partial writes of a word" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneWriteBuffer(4, 2, sdram_bb_cfg())) {
+      c => new WishboneWriteBufferMergeTester(c)
+    } should be (true)
+  }
+
+  "WishboneWriteBuffer" should "forward a read of buffered bytes" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneWriteBuffer(4, 2, sdram_bb_cfg())) {
+      c => new WishboneWriteBufferForwardTester(c)
+    } should be (true)
+  }
+
+  "WishboneWriteBuffer" should "write a partly buffered word before reading it" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneWriteBuffer(4, 2, sdram_bb_cfg())) {
+      c => new WishboneWriteBufferReadWaitTester(c)
+    } should be (true)
+  }
+
+  "WishboneWriteBuffer" should "drain an entry when full" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneWriteBuffer(4, 2, sdram_bb_cfg())) {
+      c => new WishboneWriteBufferFullTester(c)
+    } should be (true)
+  }
+
+  "WishboneWriteBuffer" should "keep local acks behind reads in flight" in {
+    Driver.execute(Array("--backend-name", "treadle"), () => new WishboneWriteBuffer(4, 2, sdram_bb_cfg())) {
+      c => new WishboneWriteBufferOrderTester(c)
+    } should be (true)
+  }
+}
@@ -0,0 +1,90 @@
+// sdrambench: clocks per second of the SDRAM model on a synthetic command
+// stream shaped like the controller's
+//
+//   sdrambench [clocks]
+//
+// The stream is the init sequence, then an auto refresh every 781 clocks
+// (all 8192 rows within 64 ms at the model's default 100 MHz) and, between
+// refreshes, one row of a bank activated and read and written every few
+// clocks.  Only the pin level call and the default geometry are used, so
+// the same file builds against older versions of the model to compare
+// them.  The model's own messages go to stdout and the result to stderr:
+//
+//   ./sdrambench 20000000 > /dev/null
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+
+#include "sdramsim.h"
+
+#define	REFRESH_CLOCKS	781
+#define	PWRUP_CLOCKS	10000	// 100 uS at 100 MHz
+
+static SDRAMSIM	*sim;
+static unsigned long	tick;
+static unsigned	sum;
+
+static void	cmd(int ras_n, int cas_n, int we_n, int bs = 0, unsigned addr = 0,
+		int driv = 0, int data = 0) {
+	sum += (*sim)(1, 1, 0, ras_n, cas_n, we_n, bs, addr, driv, data, 0);
+	tick++;
+}
+
+static void	nop(int n) {
+	while(n-- > 0)
+		cmd(1, 1, 1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long	clocks = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000000ul;
+	unsigned long	row = 0;
+	struct timespec	t0, t1;
+
+	sim = new SDRAMSIM();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	// Init: power up wait, PRECHARGE all, two REFRESH, mode BL 2 CL 2
+	nop(PWRUP_CLOCKS + 10);
+	cmd(0, 1, 0, 0, 0x400);
+	nop(4);
+	cmd(0, 0, 1);
+	nop(10);
+	cmd(0, 0, 1);
+	nop(10);
+	cmd(0, 0, 0, 0, 0x021);
+	nop(3);
+
+	while(tick < clocks) {
+		unsigned long	start = tick;
+		int		bs = row & 3;
+
+		// ACTIVATE, a READ and a WRITE every 8 clocks, then PRECHARGE
+		// all and REFRESH, REFRESH_CLOCKS in all
+		cmd(0, 1, 1, bs, row & 0x1fff);
+		nop(2);
+		for(unsigned col=0; tick + 8 <= start + REFRESH_CLOCKS - 11; col += 2) {
+			cmd(1, 0, 1, bs, col & 0x1ff);
+			nop(3);
+			cmd(1, 0, 0, bs, col & 0x1ff, 1, col);
+			nop(3);
+		}
+		nop(start + REFRESH_CLOCKS - 11 - tick);
+		cmd(0, 1, 0, 0, 0x400);
+		nop(2);
+		cmd(0, 0, 1);
+		nop(7);
+		row++;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	double	secs = (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+
+	fprintf(stderr, "%lu clocks in %.3f s: %.2f Mclocks/s (read data sum %08x)\n",
+		tick, secs, (secs > 0) ? tick / secs / 1e6 : 0.0, sum);
+	delete sim;
+	return 0;
+}
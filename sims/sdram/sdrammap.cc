@@ -0,0 +1,162 @@
+// sdrammap: row hit rates of a captured SDRAM access stream (+sdram_capture)
+// under each address mapping of the controller (SDRAM_ADDR_MAP)
+//
+//   sdrammap <capture file>
+//
+// Every READ and WRITE command of the capture is turned back into its bus
+// address, with the mapping the capture was taken with.  That address
+// stream is then run against the open row of every bank, once per mapping:
+// a row stays open until an access to another row of its bank, or until
+// a refresh of the capture closes them all.  This is the controller's
+// page policy, without its timing, so the numbers are for comparing the
+// mappings on one workload; the capture's own mapping should come out
+// close to the row hits the model counted (sdramreplay -s).  Every miss
+// and conflict is an ACTIVATE, so the activate column is their sum.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sdramsim.h"
+#include "sdramcapture.h"
+
+static const char *map_name[SDRAM_NMAPS] = {
+	"row-bank-column", "bank-row-column", "xor-bank" };
+
+struct	MAPSTATS {
+	SDRAMCFG	cfg;
+	int		open[MAX_NBANKS];	// open row, -1 for none
+	uint64_t	hit, miss, conflict;
+
+	void	access(uint64_t busword) {
+		uint64_t	w = cfg.to_store(busword) >> cfg.col_w;
+		int		bank = w & ((1u << cfg.bank_w)-1);
+		int		row  = (int)(w >> cfg.bank_w);
+
+		if (open[bank] == row)
+			hit++;
+		else if (open[bank] < 0)
+			miss++;
+		else
+			conflict++;
+		open[bank] = row;
+	}
+
+	void	close_all(void) {
+		for(int b=0; b<MAX_NBANKS; b++)
+			open[b] = -1;
+	}
+};
+
+int main(int argc, char **argv)
+{
+	SDRAMCAPTURE_HDR	hdr;
+	SDRAMCFG	cfg;
+	SDRAMSIM	*sim;
+	FILE		*fp;
+	struct stat	st;
+	long		start;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <capture file>\n", argv[0]);
+		return 1;
+	}
+	if (!(fp = fopen(argv[1], "rb"))) {
+		fprintf(stderr, "Cannot open %s\n", argv[1]);
+		return 1;
+	}
+	if ((fread(&hdr, sizeof(hdr), 1, fp) != 1)
+			||(memcmp(hdr.magic, SDRAMCAPTURE_MAGIC, sizeof(hdr.magic)) != 0)
+			||(hdr.recsize != sizeof(SDRAMCAPTURE_REC))
+			||(!SDRAMSIM::snapshot_cfg(fp, &cfg))) {
+		fprintf(stderr, "%s is not an SDRAM capture (or a different version)\n", argv[1]);
+		return 1;
+	}
+
+	// Only to get past the snapshot, and for the rows open at its start
+	sim = new SDRAMSIM(cfg);
+	if (!sim->restore(fp))
+		return 1;
+	start = ftell(fp);
+
+	const SDRAMCAPTURE_REC	*rec;
+	size_t		nrec;
+	char		*map;
+
+	fstat(fileno(fp), &st);
+	nrec = (st.st_size - start) / sizeof(SDRAMCAPTURE_REC);
+	map = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Cannot map %s\n", argv[1]);
+		return 1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	rec = (const SDRAMCAPTURE_REC *)(map + start);
+
+	MAPSTATS	ms[SDRAM_NMAPS];
+	int		row[MAX_NBANKS];	// rows the capture opened
+	unsigned	colmsk = (1u << cfg.col_w)-1;
+
+	for(int m=0; m<SDRAM_NMAPS; m++) {
+		ms[m].cfg = cfg;
+		ms[m].cfg.addr_map = m;
+		ms[m].hit = ms[m].miss = ms[m].conflict = 0;
+		ms[m].close_all();
+	}
+	for(int b=0; b<MAX_NBANKS; b++)
+		row[b] = 0;
+
+	for(size_t i=0; i<nrec; i++) {
+		unsigned	ctl = rec[i].ctl;
+		unsigned	bs = SDRAM_CTL_BS(ctl), addr = SDRAM_CTL_ADDR(ctl);
+
+		if ((!SDRAM_CTL_CKE(ctl))||(SDRAM_CTL_CS_N(ctl)))
+			continue;
+		switch((SDRAM_CTL_RAS_N(ctl)<<2)|(SDRAM_CTL_CAS_N(ctl)<<1)|SDRAM_CTL_WE_N(ctl)) {
+		case 3:	// ACTIVATE
+			row[bs] = addr & ((1u << cfg.row_w)-1);
+			break;
+		case 1:	// AUTO REFRESH, every bank closed
+			for(int m=0; m<SDRAM_NMAPS; m++)
+				ms[m].close_all();
+			break;
+		case 5:	// READ
+		case 4:	// WRITE
+			{
+				uint64_t	w = ((((uint64_t)row[bs] << cfg.bank_w) | bs)
+						<< cfg.col_w) | (addr & colmsk);
+				uint64_t	busword = cfg.to_bus(w);
+
+				for(int m=0; m<SDRAM_NMAPS; m++)
+					ms[m].access(busword);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	printf("%s: %u-bit, %u row, %u bank, %u column bits, %zu records\n",
+		argv[1], cfg.data_w, cfg.row_w, cfg.bank_w, cfg.col_w, nrec);
+	printf("  %-16s %10s %10s %8s %8s %9s %10s\n", "mapping", "accesses",
+		"hits", "", "misses", "conflicts", "activates");
+	for(int m=0; m<SDRAM_NMAPS; m++) {
+		uint64_t	n = ms[m].hit + ms[m].miss + ms[m].conflict;
+		double		d = (n) ? 100.0 / n : 0.0;
+
+		printf("  %-16s %10lu %10lu %7.2f%% %7.2f%% %8.2f%% %10lu%s\n",
+			map_name[m], (unsigned long)n, (unsigned long)ms[m].hit,
+			ms[m].hit * d, ms[m].miss * d, ms[m].conflict * d,
+			(unsigned long)(ms[m].miss + ms[m].conflict),
+			(m == (int)cfg.addr_map) ? "  (captured)" : "");
+	}
+
+	munmap(map, st.st_size);
+	fclose(fp);
+	delete sim;
+	return 0;
+}
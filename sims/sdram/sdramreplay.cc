@@ -0,0 +1,122 @@
+// sdramreplay: run a captured SDRAM command stream (+sdram_capture)
+// through the SDRAM model, as fast as it goes
+//
+//   sdramreplay [-s] [-H] [-m <heatmap>] <capture file>
+//
+// Prints the clocks replayed per second and the hash of the final memory
+// contents, which must match the "memory hash" the simulation printed.
+// -s also prints the model statistics, -H uses hugepages for the memory,
+// -m writes the heatmap of the replayed traffic (as +sdram_heatmap).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sdramsim.h"
+#include "sdramcapture.h"
+
+int main(int argc, char **argv)
+{
+	SDRAMCAPTURE_HDR	hdr;
+	SDRAMCFG	cfg;
+	SDRAMSIM	*sim;
+	bool		stats = false, huge = false;
+	const char	*fname = NULL, *hname = NULL;
+	SDRAMHEAT	*heat = NULL;
+	FILE		*fp;
+	struct stat	st;
+	long		start;
+
+	for(int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "-s") == 0)
+			stats = true;
+		else if (strcmp(argv[i], "-H") == 0)
+			huge = true;
+		else if ((strcmp(argv[i], "-m") == 0)&&(i+1 < argc))
+			hname = argv[++i];
+		else
+			fname = argv[i];
+	}
+	if (!fname) {
+		fprintf(stderr, "Usage: %s [-s] [-H] [-m <heatmap>] <capture file>\n", argv[0]);
+		return 1;
+	}
+	if (!(fp = fopen(fname, "rb"))) {
+		fprintf(stderr, "Cannot open %s\n", fname);
+		return 1;
+	}
+	if ((fread(&hdr, sizeof(hdr), 1, fp) != 1)
+			||(memcmp(hdr.magic, SDRAMCAPTURE_MAGIC, sizeof(hdr.magic)) != 0)
+			||(hdr.recsize != sizeof(SDRAMCAPTURE_REC))
+			||(!SDRAMSIM::snapshot_cfg(fp, &cfg))) {
+		fprintf(stderr, "%s is not an SDRAM capture (or a different version)\n", fname);
+		return 1;
+	}
+
+	sim = new SDRAMSIM(cfg, huge);
+	if (!sim->restore(fp))
+		return 1;
+	start = ftell(fp);
+	if (hname) {
+		heat = new SDRAMHEAT(cfg);
+		sim->heat(heat);
+	}
+
+	// The records, mapped in one piece
+	const SDRAMCAPTURE_REC	*rec;
+	size_t		nrec;
+	char		*map;
+
+	fstat(fileno(fp), &st);
+	nrec = (st.st_size - start) / sizeof(SDRAMCAPTURE_REC);
+	map = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Cannot map %s\n", fname);
+		return 1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	rec = (const SDRAMCAPTURE_REC *)(map + start);
+
+	printf("%s: %u-bit, %u row, %u bank, %u column bits @ 0x%08lx, %zu records\n",
+		fname, cfg.data_w, cfg.row_w, cfg.bank_w, cfg.col_w,
+		(unsigned long)hdr.base, nrec);
+
+	struct timespec	t0, t1;
+	uint64_t	first = (nrec) ? rec[0].cycle : 0, last = first;
+	unsigned	sum = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(size_t i=0; i<nrec; i++) {
+		sum += sim->cycle(rec[i].cycle, rec[i].ctl, rec[i].data);
+		last = rec[i].cycle;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	double	secs = (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+	uint64_t	clocks = (nrec) ? last - first + 1 : 0;
+
+	printf("%lu clocks (%zu calls) in %.3f s: %.1f Mclocks/s, %.1f Mcalls/s\n",
+		(unsigned long)clocks, nrec, secs,
+		(secs > 0) ? clocks / secs / 1e6 : 0.0,
+		(secs > 0) ? nrec / secs / 1e6 : 0.0);
+	printf("memory hash %016lx (read data sum %08x)\n",
+		(unsigned long)sim->mem()->hash(), sum);
+	if (stats)
+		sim->stats().print(stdout, "SDRAM", 1 << cfg.bank_w);
+	if (heat) {
+		heat->summary(stdout, "SDRAM");
+		if (!heat->save(hname, hdr.base))
+			fprintf(stderr, "Cannot write %s\n", hname);
+		delete heat;
+	}
+
+	munmap(map, st.st_size);
+	fclose(fp);
+	delete sim;
+	return 0;
+}
@@ -0,0 +1,79 @@
+// sdramtrace: decode a binary SDRAM model trace (+sdram_trace=full) to text
+//
+//   sdramtrace [-c] <trace file>
+//
+// -c only prints the per-operation counts.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdramtrace.h"
+
+int main(int argc, char **argv)
+{
+	SDRAMTRACE_HDR	hdr;
+	SDRAMTRACE_REC	r;
+	unsigned long	count[SDRAMTRACE_NOPS+1];
+	bool		counts_only = false;
+	const char	*fname = NULL;
+	FILE		*fp;
+
+	for(int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "-c") == 0)
+			counts_only = true;
+		else
+			fname = argv[i];
+	}
+	if (!fname) {
+		fprintf(stderr, "Usage: %s [-c] <trace file>\n", argv[0]);
+		return 1;
+	}
+	if (!(fp = fopen(fname, "rb"))) {
+		fprintf(stderr, "Cannot open %s\n", fname);
+		return 1;
+	}
+	if ((fread(&hdr, sizeof(hdr), 1, fp) != 1)
+			||(memcmp(hdr.magic, SDRAMTRACE_MAGIC, sizeof(hdr.magic)) != 0)
+			||(hdr.recsize != sizeof(SDRAMTRACE_REC))) {
+		fprintf(stderr, "%s is not an SDRAM trace (or a different version)\n", fname);
+		return 1;
+	}
+
+	memset(count, 0, sizeof(count));
+	while(fread(&r, sizeof(r), 1, fp) == 1) {
+		unsigned	op = (r.op < SDRAMTRACE_NOPS) ? r.op : SDRAMTRACE_NOPS;
+
+		count[op]++;
+		if (counts_only)
+			continue;
+		printf("%12lu %-6s ", (unsigned long)r.tick, SDRAMTRACE::opname(r.op));
+		switch(r.op) {
+		case SDRAMTRACE_ACT:
+			printf("bank %d row %04x\n", r.bank, r.addr);
+			break;
+		case SDRAMTRACE_PRE:
+			printf("bank %d\n", r.bank);
+			break;
+		case SDRAMTRACE_MODE:
+			printf("%03x\n", r.addr);
+			break;
+		case SDRAMTRACE_RD:
+			printf("SDRAM[%08x] => %04x\n", r.addr, r.data);
+			break;
+		case SDRAMTRACE_WR:
+			printf("SDRAM[%08x] <= %04x (dqm %x)\n", r.addr, r.data, r.dqm);
+			break;
+		default:
+			printf("\n");
+			break;
+		}
+	}
+	fclose(fp);
+
+	for(unsigned op=0; op<=SDRAMTRACE_NOPS; op++)
+		if (count[op])
+			fprintf((counts_only)?stdout:stderr, "%-6s %lu\n",
+				SDRAMTRACE::opname(op), count[op]);
+	return 0;
+}
@@ -0,0 +1,29 @@
+// See LICENSE for license details.
+
+#ifndef _RATONA_SDRAMPERF_H
+#define _RATONA_SDRAMPERF_H
+
+/* Register offsets, 64 bit counters (low word first) */
+
+#define SDRAMPERF_REG_CTRL      0x00
+#define SDRAMPERF_REG_CYCLES    0x08
+#define SDRAMPERF_REG_READS     0x10
+#define SDRAMPERF_REG_WRITES    0x18
+#define SDRAMPERF_REG_ROW_HIT   0x20
+#define SDRAMPERF_REG_ROW_MISS  0x28
+#define SDRAMPERF_REG_REFRESH   0x30
+#define SDRAMPERF_REG_STALL     0x38
+#define SDRAMPERF_REG_LAT_SUM   0x40
+#define SDRAMPERF_REG_LAT_COUNT 0x48
+#define SDRAMPERF_REG_LAT_MAX   0x50
+#define SDRAMPERF_REG_PF_HIT    0x58
+#define SDRAMPERF_REG_PF_MISS   0x60
+#define SDRAMPERF_REG_PF_ISSUE  0x68
+#define SDRAMPERF_REG_PF_DROP   0x70
+#define SDRAMPERF_REG_STARVE(p) (0x78 + 8 * (p))
+
+/* Fields */
+#define SDRAMPERF_CTRL_FREEZE   (1UL << 0)
+#define SDRAMPERF_CTRL_CLEAR    (1UL << 1)
+
+#endif /* _RATONA_SDRAMPERF_H */
@@ -11,6 +11,7 @@
 #include "devices/spi.h"
 #include "devices/i2c.h"
 #include "devices/codec.h"
+#include "devices/sdramperf.h"
 #include "devices/uart.h"
 
  // Some things missing from the official encoding.h
@@ -55,6 +56,8 @@
 #define I2C_CTRL_SIZE _AC(0x1000,UL)
 #define CODEC_CTRL_ADDR _AC(0x10004000,UL)
 #define CODEC_CTRL_SIZE _AC(0x1000,UL)
+#define SDRAMPERF_CTRL_ADDR _AC(0x10007000,UL)
+#define SDRAMPERF_CTRL_SIZE _AC(0x1000,UL)
 #define MEMORY_MEM_ADDR _AC(0x80000000,UL)
 #define MEMORY_MEM_SIZE _AC(0x2000000,UL)
 #define MEMORY_MEM2_ADDR _AC(0x82200000,UL)
@@ -82,6 +85,7 @@
 #define SPI_REG(offset) _REG32(SPI_CTRL_ADDR, offset)
 #define I2C_REG(offset) _REG32(I2C_CTRL_ADDR, offset)
 #define CODEC_REG(offset) _REG32(CODEC_CTRL_ADDR, offset)
+#define SDRAMPERF_REG(offset) _REG32(SDRAMPERF_CTRL_ADDR, offset)
 #define UART_REG(offset) _REG32(UART_CTRL_ADDR, offset)
 #define CLINT_REG64(offset) _REG64(CLINT_CTRL_ADDR, offset)
 #define DEBUG_REG64(offset) _REG64(DEBUG_CTRL_ADDR, offset)
@@ -93,6 +97,7 @@
 #define SPI_REG64(offset) _REG64(SPI_CTRL_ADDR, offset)
 #define I2C_REG64(offset) _REG64(I2C_CTRL_ADDR, offset)
 #define CODEC_REG64(offset) _REG64(CODEC_CTRL_ADDR, offset)
+#define SDRAMPERF_REG64(offset) _REG64(SDRAMPERF_CTRL_ADDR, offset)
 #define UART_REG64(offset) _REG64(UART_CTRL_ADDR, offset)
 
 // Misc